@@ -8,45 +8,74 @@ Mat frame, hsv, mask;
 string trackbarWindow = "Trackbars";
 string imageWindow = "Images";
 
+// 表示用に縮小した画像 (起動時に一度だけ作る)
+const Size panelSize(600, 500);
+Mat hsvSmall, frameSmall;
+Mat hsvChannels[3];  // 縮小HSVのH, S, V各チャンネル
+Mat channelMask[3];  // チャンネルごとの合否マスク
+Mat combined;        // 元画像 | マスク | 抽出結果 を並べた表示バッファ
+
+// チャンネルごとの合否表 (値 -> 0 or 255)
+Mat lut[3];
+
+// スライダー変更の記録 (描画はメインループでまとめて行う)
+bool channelDirty[3] = {true, true, true};
+bool needsRender = true;
+int channelIds[3] = {0, 1, 2};
+
+const char* minNames[3] = {"H Min", "S Min", "V Min"};
+const char* maxNames[3] = {"H Max", "S Max", "V Max"};
+
 // トラックバーのコールバック関数
-void onTrackbar(int, void*) {
-    // トラックバーの現在値を取得
-    int hMin = getTrackbarPos("H Min", trackbarWindow);
-    int hMax = getTrackbarPos("H Max", trackbarWindow);
-    int sMin = getTrackbarPos("S Min", trackbarWindow);
-    int sMax = getTrackbarPos("S Max", trackbarWindow);
-    int vMin = getTrackbarPos("V Min", trackbarWindow);
-    int vMax = getTrackbarPos("V Max", trackbarWindow);
-
-    // マスクを作成
-    Scalar lower(hMin, sMin, vMin);
-    Scalar upper(hMax, sMax, vMax);
-    inRange(hsv, lower, upper, mask);
-
-    // 結果を作成
-    Mat result;
-    bitwise_and(frame, frame, result, mask);
-
-    // マスクを3チャンネルに変換
-    Mat mask_3ch;
-    cvtColor(mask, mask_3ch, COLOR_GRAY2BGR);
-
-    // 画像を縦に連結
-    Mat combined;
-    vector<Mat> images = {frame, mask_3ch, result};
-    hconcat(images, combined);
-
-    // ウィンドウサイズに合わせてリサイズ
-    Mat resizedCombined;
-    resize(combined, resizedCombined, Size(1800, 500)); // 幅600、高さ400にリサイズ
+// 変更されたチャンネルに印を付けるだけにして、連続したイベントは次の描画で1回にまとめる
+void onTrackbar(int, void* userdata) {
+    if (userdata) {
+        channelDirty[*(int*)userdata] = true;
+    }
+    needsRender = true;
+}
+
+// 変更されたチャンネルだけ合否表とマスクを作り直す
+void updateChannel(int c) {
+    int lo = getTrackbarPos(minNames[c], trackbarWindow);
+    int hi = getTrackbarPos(maxNames[c], trackbarWindow);
+
+    uchar* table = lut[c].ptr<uchar>();
+    for (int i = 0; i < 256; i++) {
+        table[i] = (i >= lo && i <= hi) ? 255 : 0;
+    }
+    LUT(hsvChannels[c], lut[c], channelMask[c]);
+    channelDirty[c] = false;
+}
+
+void render() {
+    for (int c = 0; c < 3; c++) {
+        if (channelDirty[c]) {
+            updateChannel(c);
+        }
+    }
+
+    // マスクを作成 (inRange と同じ結果)
+    bitwise_and(channelMask[0], channelMask[1], mask);
+    bitwise_and(mask, channelMask[2], mask);
+
+    // 表示バッファの該当部分だけ書き換える (元画像部分は起動時に書き込み済み)
+    int w = panelSize.width;
+    Mat maskPanel = combined(Rect(w, 0, w, panelSize.height));
+    Mat resultPanel = combined(Rect(w * 2, 0, w, panelSize.height));
+    cvtColor(mask, maskPanel, COLOR_GRAY2BGR);
+    resultPanel.setTo(Scalar::all(0));
+    frameSmall.copyTo(resultPanel, mask);
 
     // 表示
-    imshow(imageWindow, resizedCombined);
+    imshow(imageWindow, combined);
 
     // 現在の値を出力
-    cout << "\rH: " << hMin << "-" << hMax << " "
-         << "S: " << sMin << "-" << sMax << " "
-         << "V: " << vMin << "-" << vMax << "    " << flush;
+    cout << "\rH: " << getTrackbarPos("H Min", trackbarWindow) << "-" << getTrackbarPos("H Max", trackbarWindow) << " "
+         << "S: " << getTrackbarPos("S Min", trackbarWindow) << "-" << getTrackbarPos("S Max", trackbarWindow) << " "
+         << "V: " << getTrackbarPos("V Min", trackbarWindow) << "-" << getTrackbarPos("V Max", trackbarWindow) << "    " << flush;
+
+    needsRender = false;
 }
 
 int main(int argc, char** argv) {
@@ -64,17 +93,28 @@ int main(int argc, char** argv) {
     // BGRからHSVに変換
     cvtColor(frame, hsv, COLOR_BGR2HSV);
 
+    // 表示サイズに縮小したコピーを用意
+    // HSVは値が混ざらないよう最近傍で縮小する
+    resize(frame, frameSmall, panelSize, 0, 0, INTER_AREA);
+    resize(hsv, hsvSmall, panelSize, 0, 0, INTER_NEAREST);
+    split(hsvSmall, hsvChannels);
+    for (int c = 0; c < 3; c++) {
+        lut[c].create(1, 256, CV_8U);
+    }
+    combined.create(panelSize.height, panelSize.width * 3, CV_8UC3);
+    frameSmall.copyTo(combined(Rect(0, 0, panelSize.width, panelSize.height)));
+
     // トラックバー用ウィンドウ
     namedWindow(trackbarWindow, WINDOW_NORMAL);
     resizeWindow(trackbarWindow, 300, 600); // トラックバーウィンドウのサイズ
 
     // トラックバーを作成
-    createTrackbar("H Min", trackbarWindow, 0, 180, onTrackbar);
-    createTrackbar("H Max", trackbarWindow, 0, 180, onTrackbar);
-    createTrackbar("S Min", trackbarWindow, 0, 255, onTrackbar);
-    createTrackbar("S Max", trackbarWindow, 0, 255, onTrackbar);
-    createTrackbar("V Min", trackbarWindow, 0, 255, onTrackbar);
-    createTrackbar("V Max", trackbarWindow, 0, 255, onTrackbar);
+    createTrackbar("H Min", trackbarWindow, 0, 180, onTrackbar, &channelIds[0]);
+    createTrackbar("H Max", trackbarWindow, 0, 180, onTrackbar, &channelIds[0]);
+    createTrackbar("S Min", trackbarWindow, 0, 255, onTrackbar, &channelIds[1]);
+    createTrackbar("S Max", trackbarWindow, 0, 255, onTrackbar, &channelIds[1]);
+    createTrackbar("V Min", trackbarWindow, 0, 255, onTrackbar, &channelIds[2]);
+    createTrackbar("V Max", trackbarWindow, 0, 255, onTrackbar, &channelIds[2]);
 
     // 初期値を設定
     setTrackbarPos("H Max", trackbarWindow, 180);
@@ -86,13 +126,16 @@ int main(int argc, char** argv) {
     resizeWindow(imageWindow, 600, 400); // 画像ウィンドウのサイズ
 
     // 初回表示
-    onTrackbar(0, 0);
+    render();
 
     // キー入力待ち
+    // 変更があったときだけ描画するので、スライダーを速く動かしても描画は1フレーム1回
     while (true) {
-        char key = (char)waitKey(30);
+        char key = (char)waitKey(10);
         if (key == 'q') 
             break;
+        if (needsRender)
+            render();
     }
 
     return 0;
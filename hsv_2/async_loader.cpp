@@ -0,0 +1,433 @@
+#include "async_loader.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_IO_URING
+namespace
+{
+    // liburing を使わずにシステムコールで直接 io_uring を扱う最小限の実装
+    class Ring
+    {
+    public:
+        bool init(unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            fd = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0)
+                return false;
+
+            sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single)
+                sqSize = cqSize = std::max(sqSize, cqSize);
+
+            sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sqPtr == MAP_FAILED)
+            {
+                sqPtr = nullptr;
+                return false;
+            }
+            cqPtr = single ? sqPtr : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqPtr == MAP_FAILED)
+            {
+                cqPtr = nullptr;
+                return false;
+            }
+            sqeSize = params.sq_entries * sizeof(io_uring_sqe);
+            void *sqePtr = mmap(nullptr, sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqePtr == MAP_FAILED)
+                return false;
+            sqes = static_cast<io_uring_sqe *>(sqePtr);
+
+            char *sq = static_cast<char *>(sqPtr);
+            sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            sqEntries = params.sq_entries;
+
+            char *cq = static_cast<char *>(cqPtr);
+            cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        ~Ring()
+        {
+            if (sqes)
+                munmap(sqes, sqeSize);
+            if (cqPtr && cqPtr != sqPtr)
+                munmap(cqPtr, cqSize);
+            if (sqPtr)
+                munmap(sqPtr, sqSize);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        unsigned capacity() const { return sqEntries; }
+
+        // 読み込み要求を1つ積む (発行は submitAndWait で行う)
+        void prepareRead(int fileFd, iovec *iov, size_t offset, uint64_t userData)
+        {
+            unsigned tail = *sqTail;
+            unsigned index = tail & sqMask;
+            io_uring_sqe &sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = fileFd;
+            sqe.addr = reinterpret_cast<uint64_t>(iov);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            pending++;
+        }
+
+        // 積んだ要求を発行し、少なくとも1つ完了するまで待つ
+        // シグナルで中断された場合はやり直す
+        bool submitAndWait()
+        {
+            int ret;
+            do
+            {
+                ret = int(syscall(__NR_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            } while (ret < 0 && errno == EINTR);
+            if (ret < 0)
+                return false;
+            pending -= unsigned(ret);
+            return true;
+        }
+
+        // 完了した要求を1つ取り出す (なければ false)
+        bool pop(uint64_t &userData, int &result)
+        {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+                return false;
+            const io_uring_cqe &cqe = cqes[head & cqMask];
+            userData = cqe.user_data;
+            result = cqe.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+    private:
+        int fd = -1;
+        void *sqPtr = nullptr;
+        void *cqPtr = nullptr;
+        size_t sqSize = 0, cqSize = 0, sqeSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr;
+        unsigned sqMask = 0, sqEntries = 0;
+        unsigned *cqHead = nullptr, *cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe *cqes = nullptr;
+        unsigned pending = 0;
+    };
+}
+#endif
+
+AsyncBmpLoader::AsyncBmpLoader(int queueDepth, Backend backend)
+    : queueDepth(std::max(1, queueDepth)), backend(backend), usedUring(false), slots(this->queueDepth)
+{
+    decoder.setVerbose(false);
+}
+
+bool AsyncBmpLoader::ioUringAvailable()
+{
+#ifdef HAVE_IO_URING
+    Ring ring;
+    return ring.init(4);
+#else
+    return false;
+#endif
+}
+
+const char *AsyncBmpLoader::backendName() const
+{
+    return usedUring ? "io_uring" : "thread_pool";
+}
+
+// ファイルを開いてサイズ分のバッファを用意する (バッファは縮めずに使い回す)
+bool AsyncBmpLoader::openSlot(Slot &slot, const std::string &filename)
+{
+    slot.fd = open(filename.c_str(), O_RDONLY);
+    if (slot.fd < 0)
+    {
+        printf("ファイルを開けませんでした: %s\n", filename.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(slot.fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(slot.fd);
+        slot.fd = -1;
+        printf("ファイルを開けませんでした: %s\n", filename.c_str());
+        return false;
+    }
+    slot.size = size_t(st.st_size);
+    slot.done = 0;
+    if (slot.buffer.size() < slot.size)
+        slot.buffer.resize(slot.size);
+    return true;
+}
+
+int AsyncBmpLoader::run(const std::vector<std::string> &files, const ImageCallback &onImage)
+{
+    usedUring = false;
+    failed = false;
+#ifdef HAVE_IO_URING
+    if (backend != THREAD_POOL)
+    {
+        std::vector<std::string> remaining;
+        int loaded = runUring(files, onImage, remaining);
+        if (loaded >= 0 && remaining.empty())
+        {
+            usedUring = true;
+            return loaded;
+        }
+        if (backend == IO_URING)
+        {
+            usedUring = (loaded >= 0);
+            failed = true;
+            return std::max(loaded, 0);
+        }
+        if (loaded >= 0)
+        {
+            // 途中で io_uring が使えなくなったので、残りをスレッドプールで読む
+            return loaded + runThreadPool(remaining, onImage);
+        }
+    }
+#endif
+    return runThreadPool(files, onImage);
+}
+
+#ifdef HAVE_IO_URING
+int AsyncBmpLoader::runUring(const std::vector<std::string> &files, const ImageCallback &onImage, std::vector<std::string> &remaining)
+{
+    Ring ring;
+    if (!ring.init(unsigned(queueDepth)))
+        return -1;
+
+    size_t depth = std::min<size_t>(slots.size(), ring.capacity());
+    std::vector<iovec> iovs(depth);
+    std::vector<size_t> freeSlots;
+    for (size_t i = 0; i < depth; i++)
+        freeSlots.push_back(i);
+
+    auto submit = [&](size_t index)
+    {
+        Slot &slot = slots[index];
+        iovs[index].iov_base = slot.buffer.data() + slot.done;
+        iovs[index].iov_len = slot.size - slot.done;
+        ring.prepareRead(slot.fd, &iovs[index], slot.done, index);
+    };
+
+    size_t next = 0;
+    size_t inFlight = 0;
+    int loaded = 0;
+
+    while (next < files.size() || inFlight > 0)
+    {
+        // 空いているバッファの分だけ読み込みを発行する
+        while (!freeSlots.empty() && next < files.size())
+        {
+            size_t index = freeSlots.back();
+            Slot &slot = slots[index];
+            slot.file = next++;
+            if (!openSlot(slot, files[slot.file]))
+                continue;
+            freeSlots.pop_back();
+            submit(index);
+            inFlight++;
+        }
+        if (inFlight == 0)
+            break;
+
+        if (!ring.submitAndWait())
+        {
+            printf("io_uring の待機に失敗しました: %s\n", std::strerror(errno));
+            // 読み込み途中のファイルとまだ発行していないファイルを返す
+            for (size_t i = 0; i < depth; i++)
+            {
+                if (std::find(freeSlots.begin(), freeSlots.end(), i) != freeSlots.end())
+                    continue;
+                remaining.push_back(files[slots[i].file]);
+                close(slots[i].fd);
+                slots[i].fd = -1;
+            }
+            remaining.insert(remaining.end(), files.begin() + next, files.end());
+
+            // 取り消し前の読み込みがバッファに書き込むかもしれないので、
+            // 今のバッファは使わずに残しておき、新しいバッファに替える
+            for (auto &slot : slots)
+                retired.push_back(std::move(slot.buffer));
+            slots.assign(slots.size(), Slot());
+            return loaded;
+        }
+
+        uint64_t userData;
+        int result;
+        while (ring.pop(userData, result))
+        {
+            size_t index = size_t(userData);
+            Slot &slot = slots[index];
+            if (result > 0)
+                slot.done += size_t(result);
+
+            if (result > 0 && slot.done < slot.size)
+            {
+                // 途中までしか読めなかったので残りを読む
+                submit(index);
+                continue;
+            }
+
+            close(slot.fd);
+            slot.fd = -1;
+            inFlight--;
+            if (slot.done == slot.size && decoder.decodeBmp(slot.buffer.data(), slot.size, image))
+            {
+                onImage(files[slot.file], image);
+                loaded++;
+            }
+            else
+            {
+                printf("BMPを読み込めませんでした: %s\n", files[slot.file].c_str());
+            }
+            freeSlots.push_back(index);
+        }
+    }
+    return loaded;
+}
+#else
+int AsyncBmpLoader::runUring(const std::vector<std::string> &, const ImageCallback &, std::vector<std::string> &)
+{
+    return -1;
+}
+#endif
+
+int AsyncBmpLoader::runThreadPool(const std::vector<std::string> &files, const ImageCallback &onImage)
+{
+    std::mutex mutex;
+    std::condition_variable slotFreed, slotFilled;
+    std::deque<size_t> freeSlots, filled;
+    std::atomic<size_t> next(0);
+    size_t finishedWorkers = 0;
+
+    for (size_t i = 0; i < slots.size(); i++)
+        freeSlots.push_back(i);
+
+    // 各ワーカーは空きバッファを1つ取り、pread で読み込んで完了キューに入れる
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFreed.wait(lock, [&] { return !freeSlots.empty(); });
+                index = freeSlots.front();
+                freeSlots.pop_front();
+            }
+
+            size_t file = next++;
+            if (file >= files.size())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeSlots.push_back(index);
+                finishedWorkers++;
+                slotFreed.notify_one();
+                slotFilled.notify_one();
+                return;
+            }
+
+            Slot &slot = slots[index];
+            slot.file = file;
+            slot.opened = openSlot(slot, files[file]);
+            if (slot.opened)
+            {
+                while (slot.done < slot.size)
+                {
+                    ssize_t n = pread(slot.fd, slot.buffer.data() + slot.done, slot.size - slot.done, off_t(slot.done));
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                        break;
+                    slot.done += size_t(n);
+                }
+                close(slot.fd);
+                slot.fd = -1;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            filled.push_back(index);
+            slotFilled.notify_one();
+        }
+    };
+
+    size_t workerCount = std::min<size_t>(slots.size(), std::max<size_t>(1, files.size()));
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; i++)
+        workers.emplace_back(worker);
+
+    // 展開とコールバックは呼び出し元のスレッドで行う
+    int loaded = 0;
+    for (;;)
+    {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFilled.wait(lock, [&] { return !filled.empty() || finishedWorkers == workerCount; });
+            if (filled.empty())
+                break;
+            index = filled.front();
+            filled.pop_front();
+        }
+
+        Slot &slot = slots[index];
+        if (!slot.opened)
+        {
+            // 開けなかったファイルは openSlot で表示済み
+        }
+        else if (slot.done == slot.size && decoder.decodeBmp(slot.buffer.data(), slot.size, image))
+        {
+            onImage(files[slot.file], image);
+            loaded++;
+        }
+        else
+        {
+            printf("BMPを読み込めませんでした: %s\n", files[slot.file].c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeSlots.push_back(index);
+        slotFreed.notify_one();
+    }
+
+    for (auto &t : workers)
+        t.join();
+    return loaded;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "hsv_filter.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+// 読み込みが終わった画像を受け取るコールバック
+// 呼び出し元のスレッドで1枚ずつ呼ばれる (image は次の呼び出しで上書きされる)
+using ImageCallback = std::function<void(const std::string &filename, const std::vector<std::vector<RGB>> &image)>;
+
+// 多数のBMPを非同期に読み込むクラス
+// 確保済みのバッファに常に複数の読み込みを発行しておき、
+// 読み込みが終わったものから展開してコールバックに渡す
+// Linux では io_uring を使い、使えない環境ではスレッドプールの pread で読む
+class AsyncBmpLoader
+{
+public:
+    enum Backend
+    {
+        AUTO,       // io_uring が使えればそれを使う
+        IO_URING,
+        THREAD_POOL,
+    };
+
+    explicit AsyncBmpLoader(int queueDepth = 64, Backend backend = AUTO);
+
+    // 全ファイルを読み込み、終わったものから順にコールバックを呼ぶ
+    // 読み込めたファイル数を返す
+    int run(const std::vector<std::string> &files, const ImageCallback &onImage);
+
+    // 実際に使われたバックエンド名 ("io_uring" / "thread_pool")
+    // io_uring が途中で失敗して残りをスレッドプールで読んだ場合は "thread_pool"
+    const char *backendName() const;
+    // 直前の run が I/O エラーで中断したか (IO_URING を指定して io_uring が失敗した場合)
+    bool hasFailed() const { return failed; }
+
+    static bool ioUringAvailable();
+
+private:
+    struct Slot
+    {
+        std::vector<unsigned char> buffer; // 使い回す読み込み用バッファ
+        size_t size = 0;
+        size_t done = 0;
+        int fd = -1;
+        size_t file = 0;
+        bool opened = false;
+    };
+
+    int queueDepth;
+    Backend backend;
+    bool usedUring;
+    bool failed = false;
+    std::vector<Slot> slots;
+    std::vector<std::vector<unsigned char>> retired; // 失敗した io_uring の読み込み先だったバッファ
+    HSVFilter decoder;
+    std::vector<std::vector<RGB>> image;
+
+    bool openSlot(Slot &slot, const std::string &filename);
+    // 途中で失敗した場合は、読み込めなかったファイルを remaining に入れる
+    int runUring(const std::vector<std::string> &files, const ImageCallback &onImage, std::vector<std::string> &remaining);
+    int runThreadPool(const std::vector<std::string> &files, const ImageCallback &onImage);
+};
@@ -0,0 +1,71 @@
+#include "color_classifier.hpp"
+#include <cstring>
+
+bool ColorClassifier::addRange(FruitColor color, const HSVRange &range)
+{
+    int total = 0;
+    for (const auto &list : ranges)
+        total += int(list.size());
+    if (total >= MAX_RANGES)
+        return false;
+
+    ranges[color].push_back(range);
+    compile();
+    return true;
+}
+
+void ColorClassifier::clearRanges(FruitColor color)
+{
+    ranges[color].clear();
+    compile();
+}
+
+// [lo, hi] に入る値の位置にビットを立てる
+void ColorClassifier::setInterval(uint32_t *table, int lo, int hi, uint32_t bit)
+{
+    int low = lo;
+    int high = hi;
+    if (low < 0)
+        low = 0;
+    if (high > 256)
+        high = 256;
+
+    for (int n = low; n <= high; n++)
+    {
+        table[2 * n] |= bit; // ちょうど n
+        if (n + 1 <= high)
+            table[2 * n + 1] |= bit; // n と n+1 の間
+    }
+}
+
+// 範囲のリストから表を作り直す
+void ColorClassifier::compile()
+{
+    std::memset(hTable, 0, sizeof(hTable));
+    std::memset(sTable, 0, sizeof(sTable));
+    std::memset(vTable, 0, sizeof(vTable));
+
+    int next = 0;
+    for (int color = 0; color < NUM_FRUIT_COLORS; color++)
+    {
+        colorBits[color] = 0;
+        for (const auto &range : ranges[color])
+        {
+            uint32_t bit = 1u << next++;
+            colorBits[color] |= bit;
+
+            if (range.h_min <= range.h_max)
+            {
+                setInterval(hTable, range.h_min, range.h_max, bit);
+            }
+            else
+            {
+                // 色相が0/180をまたぐ範囲
+                setInterval(hTable, range.h_min, 180, bit);
+                setInterval(hTable, 0, range.h_max, bit);
+            }
+            setInterval(sTable, range.s_min, range.s_max, bit);
+            setInterval(vTable, range.v_min, range.v_max, bit);
+        }
+    }
+}
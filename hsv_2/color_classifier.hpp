@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct HSV {
+    double h; // 色相 0-180
+    double s; // 彩度 0-255
+    double v; // 明度 0-255
+};
+
+// HSVの範囲 (両端を含む)
+// h_min > h_max のときは色相0/180をまたぐ範囲 (例: {170, 10, ...} は 170-180 と 0-10)
+// 表は整数の境界で作るので、境界は整数で指定する
+struct HSVRange {
+    int h_min, h_max;
+    int s_min, s_max;
+    int v_min, v_max;
+};
+
+enum FruitColor {
+    APPLE_COLOR = 0,
+    ORANGE_COLOR = 1,
+    STEM_COLOR = 2,
+    NUM_FRUIT_COLORS = 3
+};
+
+// 色ごとに複数のHSV範囲を持てる判定器
+// 範囲1つにつき1ビットを割り当て、H/S/Vそれぞれの値から
+// 「その値を含む範囲のビット集合」を引く表を作っておく。
+// 判定は範囲の数によらず、表を3回引いて2回ANDするだけ
+class ColorClassifier {
+public:
+    static const int MAX_RANGES = 32;
+
+    // 範囲を追加する (合計 MAX_RANGES 個まで, 超えた場合は false)
+    bool addRange(FruitColor color, const HSVRange& range);
+    void clearRanges(FruitColor color);
+    const std::vector<HSVRange>& getRanges(FruitColor color) const { return ranges[color]; }
+
+    // ピクセルが含まれる範囲のビット集合
+    uint32_t match(const HSV& hsv) const
+    {
+        // 色相でどの範囲にも入らなければ S, V は見ない
+        uint32_t bits = hTable[index(hsv.h)];
+        if (bits == 0)
+            return 0;
+        return bits & sTable[index(hsv.s)] & vTable[index(hsv.v)];
+    }
+    // ビット集合がその色の範囲を含むか
+    bool is(uint32_t bits, FruitColor color) const { return (bits & colorBits[color]) != 0; }
+
+private:
+    // 値 x は、整数なら 2x、整数でなければ 2*floor(x)+1 の位置を引く
+    // (整数の境界なら x <= max, x >= min を小数まで正しく判定できる)
+    static const int TABLE_SIZE = 2 * 256 + 2;
+
+    std::vector<HSVRange> ranges[NUM_FRUIT_COLORS];
+    uint32_t colorBits[NUM_FRUIT_COLORS] = {0, 0, 0};
+    uint32_t hTable[TABLE_SIZE] = {0};
+    uint32_t sTable[TABLE_SIZE] = {0};
+    uint32_t vTable[TABLE_SIZE] = {0};
+
+    void compile();
+    static void setInterval(uint32_t* table, int lo, int hi, uint32_t bit);
+    static int index(double x)
+    {
+        int n = int(x);
+        return 2 * n + (x > n ? 1 : 0);
+    }
+};
@@ -1,14 +1,35 @@
 #include "hsv_filter.hpp"
+#include "png_decoder.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <iostream>
+#include <stdexcept>
 
-HSVFilter::HSVFilter()
+HSVFilter::HSVFilter() : verbose(true)
 {
-    // 初期閾値の設定
-    thresholds.apple = {0, 10, 65, 237, 30, 211}; // (11->10)
-    thresholds.orange = {11, 19, 192, 255, 162, 255};
-    thresholds.stem = {14, 41, 78, 222, 76, 161};
+    // 初期閾値の設定 (現在の範囲は getRanges で取得する)
+    classifier.addRange(APPLE_COLOR, {0, 10, 65, 237, 30, 211}); // (11->10)
+    classifier.addRange(ORANGE_COLOR, {11, 19, 192, 255, 162, 255});
+    classifier.addRange(STEM_COLOR, {14, 41, 78, 222, 76, 161});
+}
+
+bool HSVFilter::setRanges(FruitColor color, const std::vector<HSVRange> &ranges)
+{
+    std::vector<HSVRange> previous = classifier.getRanges(color);
+    classifier.clearRanges(color);
+    for (const auto &range : ranges)
+    {
+        if (!classifier.addRange(color, range))
+        {
+            // 範囲が多すぎる場合は元に戻す
+            classifier.clearRanges(color);
+            for (const auto &old : previous)
+                classifier.addRange(color, old);
+            return false;
+        }
+    }
+    return true;
 }
 
 HSV HSVFilter::rgbToHsv(RGB rgb)
@@ -28,7 +49,8 @@ HSV HSVFilter::rgbToHsv(RGB rgb)
     }
     else if (max == r)
     {
-        hsv.h = 30 * fmod(((g - b) / diff), 6);
+        // (g - b) / diff は -1〜1 なので fmod(…, 6) は値を変えない
+        hsv.h = 30 * ((g - b) / diff);
     }
     else if (max == g)
     {
@@ -49,83 +71,180 @@ HSV HSVFilter::rgbToHsv(RGB rgb)
 
 bool HSVFilter::isAppleColor(HSV hsv)
 {
-    return (hsv.h >= thresholds.apple.h_min && hsv.h <= thresholds.apple.h_max) &&
-           (hsv.s >= thresholds.apple.s_min && hsv.s <= thresholds.apple.s_max) &&
-           (hsv.v >= thresholds.apple.v_min && hsv.v <= thresholds.apple.v_max);
+    return classifier.is(classifier.match(hsv), APPLE_COLOR);
 }
 
 bool HSVFilter::isOrangeColor(HSV hsv)
 {
-    return (hsv.h >= thresholds.orange.h_min && hsv.h <= thresholds.orange.h_max) &&
-           (hsv.s >= thresholds.orange.s_min && hsv.s <= thresholds.orange.s_max) &&
-           (hsv.v >= thresholds.orange.v_min && hsv.v <= thresholds.orange.v_max);
+    return classifier.is(classifier.match(hsv), ORANGE_COLOR);
 }
 
 bool HSVFilter::isStemColor(HSV hsv)
 {
-    return (hsv.h >= thresholds.stem.h_min && hsv.h <= thresholds.stem.h_max) &&
-           (hsv.s >= thresholds.stem.s_min && hsv.s <= thresholds.stem.s_max) &&
-           (hsv.v >= thresholds.stem.v_min && hsv.v <= thresholds.stem.v_max);
+    return classifier.is(classifier.match(hsv), STEM_COLOR);
 }
 
-FruitCount HSVFilter::countFruits(const std::vector<std::vector<RGB>> &image)
+void HSVFilter::countRow(const RGB *row, size_t width, PixelCounts &counts)
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        // 範囲の数によらず表を3回引くだけで全色を判定できる
+        uint32_t bits = classifier.match(rgbToHsv(row[x]));
+
+        if (classifier.is(bits, APPLE_COLOR))
+            counts.apple++;
+        if (classifier.is(bits, ORANGE_COLOR))
+            counts.orange++;
+        if (classifier.is(bits, STEM_COLOR))
+            counts.stem++;
+    }
+}
+
+void HSVFilter::countBgrRow(const unsigned char *bgr, size_t width, PixelCounts &counts)
 {
-    int applePixels = 0;
-    int orangeColorPixels = 0;
-    int stemPixels = 0;
+    for (size_t x = 0; x < width; x++, bgr += 3)
+    {
+        RGB rgb = {bgr[2], bgr[1], bgr[0]};
+        uint32_t bits = classifier.match(rgbToHsv(rgb));
+
+        if (classifier.is(bits, APPLE_COLOR))
+            counts.apple++;
+        if (classifier.is(bits, ORANGE_COLOR))
+            counts.orange++;
+        if (classifier.is(bits, STEM_COLOR))
+            counts.stem++;
+    }
+}
+
+PixelCounts HSVFilter::countPixelsBgr(const unsigned char *bgr, int width, int height, size_t stride)
+{
+    PixelCounts counts = {0, 0, 0};
+
+    for (int y = 0; y < height; y++)
+    {
+        countBgrRow(bgr + stride * y, size_t(width), counts);
+    }
+
+    return counts;
+}
+
+PixelCounts HSVFilter::countPixels(const std::vector<std::vector<RGB>> &image)
+{
+    PixelCounts counts = {0, 0, 0};
 
     for (size_t y = 0; y < image.size(); y++)
     {
-        for (size_t x = 0; x < image[0].size(); x++)
+        countRow(image[y].data(), image[0].size(), counts);
+    }
+
+    return counts;
+}
+
+FruitCount HSVFilter::countFruits(const std::vector<std::vector<RGB>> &image)
+{
+    return estimateCount(countPixels(image));
+}
+
+std::vector<std::vector<RGB>> HSVFilter::annotate(const std::vector<std::vector<RGB>> &image)
+{
+    std::vector<std::vector<RGB>> result = image;
+
+    for (auto &row : result)
+    {
+        for (auto &pixel : row)
         {
-            HSV hsv = rgbToHsv(image[y][x]);
-
-            if (isAppleColor(hsv))
-                applePixels++;
-            if (isOrangeColor(hsv))
-                orangeColorPixels++;
-            if (isStemColor(hsv))
-                stemPixels++;
+            uint32_t bits = classifier.match(rgbToHsv(pixel));
+
+            // へた > みかん > りんご の順で優先して塗る
+            if (classifier.is(bits, STEM_COLOR))
+                pixel = {0, 0, 255};
+            else if (classifier.is(bits, ORANGE_COLOR))
+                pixel = {255, 0, 0};
+            else if (classifier.is(bits, APPLE_COLOR))
+                pixel = {0, 255, 0};
         }
     }
 
-    FruitCount count = {0, 0, 0};
+    return result;
+}
+
+FruitCount HSVFilter::countFruitsPng(const std::string &filename)
+{
+    PixelCounts counts;
+    if (!countPixelsPng(filename, counts))
+        return FruitCount{0, 0, 0};
+
+    return estimateCount(counts);
+}
+
+bool HSVFilter::countPixelsPng(const std::string &filename, PixelCounts &counts)
+{
+    counts = {0, 0, 0};
+
+    try
+    {
+        PngDecoder::decode(filename, [&](uint32_t, const RGB *row, uint32_t width)
+                           { countRow(row, width, counts); });
+    }
+    catch (const std::exception &e)
+    {
+        printf("PNGを読み込めませんでした: %s (%s)\n", filename.c_str(), e.what());
+        return false;
+    }
 
-    // 計算過程の出力
-    std::cout << "\n検出ピクセル数:\n";
-    std::cout << "りんご色のピクセル数: " << applePixels << "\n";
-    std::cout << "みかん色のピクセル数: " << orangeColorPixels << "\n";
-    std::cout << "へたのピクセル数: " << stemPixels << "\n";
+    return true;
+}
 
-    std::cout << "\n計算過程:\n";
+FruitCount HSVFilter::estimateCount(const PixelCounts &counts)
+{
+    int applePixels = counts.apple;
+    int orangeColorPixels = counts.orange;
+    int stemPixels = counts.stem;
+
+    FruitCount count = {0, 0, 0};
 
     // かきの数を計算 (へたの数から)
     count.persimmons = round((double)stemPixels / AVERAGE_STEM_PIXELS);
-    std::cout << "かきの数 = へたのピクセル数 / 平均へたピクセル数\n";
-    std::cout << "        = " << stemPixels << " / " << AVERAGE_STEM_PIXELS << "\n";
-    std::cout << "        = " << count.persimmons << "個\n";
 
     // りんごの数を計算
     count.apples = round((double)applePixels / AVERAGE_APPLE_PIXELS);
-    std::cout << "\nりんごの数 = りんご色のピクセル数 / 平均りんごピクセル数\n";
-    std::cout << "          = " << applePixels << " / " << AVERAGE_APPLE_PIXELS << "\n";
-    std::cout << "          = " << count.apples << "個\n";
 
     // みかんの数を計算 (かきの色を除外)
     int orangeOnlyPixels = orangeColorPixels - (AVERAGE_PERSIMMON_PIXELS * count.persimmons);
-    std::cout << "\nみかん色の純ピクセル数 = みかん色の総ピクセル数 - (かきの平均ピクセル数 × かきの数)\n";
-    std::cout << "                      = " << orangeColorPixels << " - ("
-              << AVERAGE_PERSIMMON_PIXELS << " × " << count.persimmons << ")\n";
-    std::cout << "                      = " << orangeOnlyPixels << "\n";
-
     count.oranges = round((double)orangeOnlyPixels / AVERAGE_ORANGE_PIXELS);
-    std::cout << "\nみかんの数 = みかん色の純ピクセル数 / 平均みかんピクセル数\n";
-    std::cout << "          = " << orangeOnlyPixels << " / " << AVERAGE_ORANGE_PIXELS << "\n";
-    std::cout << "          = " << count.oranges << "個\n";
+
+    if (verbose)
+    {
+        // 計算過程の出力
+        std::cout << "\n検出ピクセル数:\n";
+        std::cout << "りんご色のピクセル数: " << applePixels << "\n";
+        std::cout << "みかん色のピクセル数: " << orangeColorPixels << "\n";
+        std::cout << "へたのピクセル数: " << stemPixels << "\n";
+
+        std::cout << "\n計算過程:\n";
+
+        std::cout << "かきの数 = へたのピクセル数 / 平均へたピクセル数\n";
+        std::cout << "        = " << stemPixels << " / " << AVERAGE_STEM_PIXELS << "\n";
+        std::cout << "        = " << count.persimmons << "個\n";
+
+        std::cout << "\nりんごの数 = りんご色のピクセル数 / 平均りんごピクセル数\n";
+        std::cout << "          = " << applePixels << " / " << AVERAGE_APPLE_PIXELS << "\n";
+        std::cout << "          = " << count.apples << "個\n";
+
+        std::cout << "\nみかん色の純ピクセル数 = みかん色の総ピクセル数 - (かきの平均ピクセル数 × かきの数)\n";
+        std::cout << "                      = " << orangeColorPixels << " - ("
+                  << AVERAGE_PERSIMMON_PIXELS << " × " << count.persimmons << ")\n";
+        std::cout << "                      = " << orangeOnlyPixels << "\n";
+
+        std::cout << "\nみかんの数 = みかん色の純ピクセル数 / 平均みかんピクセル数\n";
+        std::cout << "          = " << orangeOnlyPixels << " / " << AVERAGE_ORANGE_PIXELS << "\n";
+        std::cout << "          = " << count.oranges << "個\n";
+    }
 
     if (count.oranges < 0)
     {
-        std::cout << "\n※ みかんの数が負数になったため0に補正\n";
+        if (verbose)
+            std::cout << "\n※ みかんの数が負数になったため0に補正\n";
         count.oranges = 0;
     }
 
@@ -168,4 +287,126 @@ std::vector<std::vector<RGB>> HSVFilter::loadBmpImage(const std::string &filenam
 
     fclose(fp);
     return image;
-}
\ No newline at end of file
+}
+
+bool HSVFilter::parseBmp(const unsigned char *data, size_t size, BmpLayout &layout)
+{
+    if (size < 54 || data[0] != 'B' || data[1] != 'M')
+        return false;
+
+    auto get32 = [&](size_t offset)
+    {
+        return uint32_t(data[offset]) | (uint32_t(data[offset + 1]) << 8) |
+               (uint32_t(data[offset + 2]) << 16) | (uint32_t(data[offset + 3]) << 24);
+    };
+    uint32_t offset = get32(10);
+    uint32_t width = get32(18);
+    uint32_t height = get32(22); // 上下反転 (負の高さ) のBMPは扱わない
+    int bitCount = data[28] | (data[29] << 8);
+    uint32_t compression = get32(30);
+    if (bitCount != 24 || compression != 0 || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX)
+        return false;
+
+    // 足し算・掛け算があふれないよう、残りのバイト数と比べる
+    size_t rowSize = size_t(width) * 3 + (4 - (size_t(width) * 3) % 4) % 4;
+    if (offset > size || height > (size - offset) / rowSize)
+        return false;
+
+    layout.bgr = data + offset;
+    layout.width = int(width);
+    layout.height = int(height);
+    layout.stride = rowSize;
+    return true;
+}
+
+bool HSVFilter::decodeBmp(const unsigned char *data, size_t size, std::vector<std::vector<RGB>> &image)
+{
+    BmpLayout layout;
+    if (!parseBmp(data, size, layout))
+        return false;
+
+    size_t width = size_t(layout.width);
+    size_t height = size_t(layout.height);
+    image.resize(height);
+    for (size_t y = 0; y < height; y++)
+    {
+        // BMPは下から上に格納されている
+        const unsigned char *src = layout.bgr + layout.stride * (height - 1 - y);
+        std::vector<RGB> &row = image[y];
+        row.resize(width);
+        for (size_t x = 0; x < width; x++)
+        {
+            row[x].r = src[x * 3 + 2];
+            row[x].g = src[x * 3 + 1];
+            row[x].b = src[x * 3];
+        }
+    }
+    return true;
+}
+
+std::vector<std::vector<RGB>> HSVFilter::loadPngImage(const std::string &filename)
+{
+    std::vector<std::vector<RGB>> image;
+
+    try
+    {
+        PngDecoder::decode(filename, [&](uint32_t, const RGB *row, uint32_t width)
+                           { image.emplace_back(row, row + width); });
+    }
+    catch (const std::exception &e)
+    {
+        printf("PNGを読み込めませんでした: %s (%s)\n", filename.c_str(), e.what());
+        return std::vector<std::vector<RGB>>();
+    }
+
+    return image;
+}
+
+bool HSVFilter::saveBmpImage(const std::vector<std::vector<RGB>> &image, const std::string &filename)
+{
+    FILE *fp = fopen(filename.c_str(), "wb");
+    if (!fp)
+    {
+        printf("ファイルを作成できませんでした: %s\n", filename.c_str());
+        return false;
+    }
+
+    int height = int(image.size());
+    int width = height ? int(image[0].size()) : 0;
+    int padding = (4 - (width * 3) % 4) % 4;
+    int rowSize = width * 3 + padding;
+    int dataSize = rowSize * height;
+
+    // 24ビット無圧縮のヘッダ (リトルエンディアン)
+    unsigned char header[54] = {'B', 'M'};
+    auto put32 = [&](int offset, int value)
+    {
+        for (int i = 0; i < 4; i++)
+            header[offset + i] = (unsigned char)((unsigned)value >> (8 * i));
+    };
+    put32(2, 54 + dataSize);
+    put32(10, 54);
+    put32(14, 40);
+    put32(18, width);
+    put32(22, height);
+    header[26] = 1;
+    header[28] = 24;
+    put32(34, dataSize);
+    fwrite(header, sizeof(unsigned char), 54, fp);
+
+    // 下の行から、BGRの順で書き込む
+    std::vector<unsigned char> row(rowSize, 0);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            row[x * 3] = image[y][x].b;
+            row[x * 3 + 1] = image[y][x].g;
+            row[x * 3 + 2] = image[y][x].r;
+        }
+        fwrite(row.data(), sizeof(unsigned char), rowSize, fp);
+    }
+
+    fclose(fp);
+    return true;
+}
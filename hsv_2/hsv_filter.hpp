@@ -2,29 +2,32 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include "color_classifier.hpp"
 
 struct RGB {
     unsigned char r, g, b;
 };
 
-struct HSV {
-    double h; // 色相 0-180
-    double s; // 彩度 0-255
-    double v; // 明度 0-255
-};
-
 struct FruitCount {
     int apples;
     int oranges;
     int persimmons;
 };
 
-struct FruitThresholds {
-    struct {
-        double h_min, h_max;
-        double s_min, s_max;
-        double v_min, v_max;
-    } apple, orange, stem;
+// 色ごとの検出ピクセル数
+struct PixelCounts {
+    int apple;
+    int orange;
+    int stem;
+};
+
+// メモリ上のBMPファイルの画素の位置
+// 行は下から上の順に stride バイトずつ並び、各ピクセルはBGRの3バイト
+struct BmpLayout {
+    const unsigned char* bgr;
+    int width;
+    int height;
+    size_t stride;
 };
 
 class HSVFilter {
@@ -32,7 +35,33 @@ public:
     HSVFilter();
     FruitCount countFruits(const std::vector<std::vector<RGB>>& image);
     std::vector<std::vector<RGB>> loadBmpImage(const std::string& filename);
-    const FruitThresholds& getThresholds() const { return thresholds; }
+    std::vector<std::vector<RGB>> loadPngImage(const std::string& filename);
+    // メモリ上のBMPファイルを展開する (image の領域は使い回す)
+    bool decodeBmp(const unsigned char* data, size_t size, std::vector<std::vector<RGB>>& image);
+    // BMPのヘッダを確かめて画素の位置を返す (24ビット無圧縮のみ, 展開はしない)
+    static bool parseBmp(const unsigned char* data, size_t size, BmpLayout& layout);
+    bool saveBmpImage(const std::vector<std::vector<RGB>>& image, const std::string& filename);
+    // PNGを1行ずつ伸張しながら判定する (画像全体を展開しない)
+    FruitCount countFruitsPng(const std::string& filename);
+    bool countPixelsPng(const std::string& filename, PixelCounts& counts);
+    // 色ごとの判定範囲を置き換える (複数の範囲, 色相0/180をまたぐ範囲も可)
+    bool setRanges(FruitColor color, const std::vector<HSVRange>& ranges);
+    const std::vector<HSVRange>& getRanges(FruitColor color) const { return classifier.getRanges(color); }
+    // false にすると計算過程を出力しない (連続処理用)
+    void setVerbose(bool v) { verbose = v; }
+
+    // 1行分のピクセルを判定して色ごとのピクセル数に加算する
+    void countRow(const RGB* row, size_t width, PixelCounts& counts);
+    // BGRの順に並んだ1行分 (カメラやBMPの生データ) を判定する
+    void countBgrRow(const unsigned char* bgr, size_t width, PixelCounts& counts);
+    // 画像全体の色ごとのピクセル数
+    PixelCounts countPixels(const std::vector<std::vector<RGB>>& image);
+    // メモリ上のBGR画像 (stride: 1行のバイト数) をコピーせずに判定する
+    PixelCounts countPixelsBgr(const unsigned char* bgr, int width, int height, size_t stride);
+    // 判定されたピクセルを色分けした画像 (りんご:緑 みかん:赤 へた:青)
+    std::vector<std::vector<RGB>> annotate(const std::vector<std::vector<RGB>>& image);
+    // 色ごとのピクセル数から果物の数を推定する
+    FruitCount estimateCount(const PixelCounts& counts);
 
 private:
     static const int AVERAGE_APPLE_PIXELS = 18376;
@@ -40,7 +69,8 @@ private:
     static const int AVERAGE_PERSIMMON_PIXELS = 13093;
     static const int AVERAGE_STEM_PIXELS = 2959;
 
-    FruitThresholds thresholds;
+    ColorClassifier classifier;
+    bool verbose;
     HSV rgbToHsv(RGB rgb);
     bool isAppleColor(HSV hsv);
     bool isOrangeColor(HSV hsv);
@@ -0,0 +1,174 @@
+// BMP読み込みのベンチマーク
+// 既存の読み込み (HSVFilter::loadBmpImage, BMPProcessor::readBMP) と
+// AsyncBmpLoader (io_uring / スレッドプール) の1秒あたりのファイル数を比較する
+// cold: 各ファイルのページキャッシュを捨ててから読む (--repeat の各回の前に捨て直す)
+// warm: キャッシュに載った状態
+//
+// 使い方: ./io_benchmark [--repeat N] [--depth N] [--classify] ファイルまたはディレクトリ...
+#include "async_loader.hpp"
+#include "hsv_filter.hpp"
+#include "../main/bmp.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+std::vector<std::string> collectFiles(const std::string &path)
+{
+    std::vector<std::string> files;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return files;
+    if (!S_ISDIR(st.st_mode))
+    {
+        files.push_back(path);
+        return files;
+    }
+    DIR *dp = opendir(path.c_str());
+    if (!dp)
+        return files;
+    while (dirent *entry = readdir(dp))
+    {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".bmp") == 0)
+            files.push_back(path + "/" + name);
+    }
+    closedir(dp);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// ページキャッシュから追い出す (書き込み済みのファイルのみ有効)
+void dropCache(const std::vector<std::string> &files)
+{
+    for (const auto &file : files)
+    {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+using LoadFunction = std::function<void(const std::vector<std::string> &)>;
+
+// 1秒あたりのファイル数
+// cold: 同じファイルを2回目以降キャッシュから読まないよう、1巡ごとにキャッシュを捨てて計測する
+// warm: 1回読んでキャッシュに載せてから、繰り返したファイル一覧をまとめて計測する
+double measure(const std::vector<std::string> &unique, const std::vector<std::string> &files, int repeat, bool cold, const LoadFunction &body)
+{
+    double seconds = 0;
+    if (cold)
+    {
+        for (int r = 0; r < repeat; r++)
+        {
+            dropCache(unique);
+            auto start = std::chrono::steady_clock::now();
+            body(unique);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    else
+    {
+        body(unique);
+        auto start = std::chrono::steady_clock::now();
+        body(files);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return files.size() / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeat = 1;
+    int depth = 64;
+    bool classify = false;
+    std::vector<std::string> unique;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--depth" && i + 1 < argc)
+            depth = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--classify")
+            classify = true;
+        else
+        {
+            auto found = collectFiles(arg);
+            unique.insert(unique.end(), found.begin(), found.end());
+        }
+    }
+    if (unique.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [--repeat N] [--depth N] [--classify] files_or_dirs...\n";
+        return 1;
+    }
+
+    // 同じファイルを繰り返して大量のファイルを模擬する
+    std::vector<std::string> files;
+    for (int r = 0; r < repeat; r++)
+        files.insert(files.end(), unique.begin(), unique.end());
+
+    HSVFilter filter;
+    filter.setVerbose(false);
+    long long checksum = 0;
+
+    auto consume = [&](const std::vector<std::vector<RGB>> &image)
+    {
+        if (classify)
+            checksum += filter.countPixels(image).orange;
+        else
+            checksum += image.size();
+    };
+
+    std::vector<std::pair<std::string, LoadFunction>> loaders;
+    loaders.push_back({"HSVFilter::loadBmpImage", [&](const std::vector<std::string> &list)
+                       {
+                           for (const auto &file : list)
+                               consume(filter.loadBmpImage(file));
+                       }});
+    loaders.push_back({"BMPProcessor::readBMP", [&](const std::vector<std::string> &list)
+                       {
+                           for (const auto &file : list)
+                           {
+                               BMPProcessor processor;
+                               processor.readBMP(file);
+                               checksum += processor.getHeight();
+                           }
+                       }});
+
+    AsyncBmpLoader uring(depth, AsyncBmpLoader::IO_URING);
+    AsyncBmpLoader pool(depth, AsyncBmpLoader::THREAD_POOL);
+    auto onImage = [&](const std::string &, const std::vector<std::vector<RGB>> &image) { consume(image); };
+    if (AsyncBmpLoader::ioUringAvailable())
+        loaders.push_back({"AsyncBmpLoader (io_uring)", [&](const std::vector<std::string> &list)
+                           {
+                               uring.run(list, onImage);
+                               if (uring.hasFailed())
+                                   std::cout << "io_uring の読み込みが途中で失敗しました\n";
+                           }});
+    else
+        std::cout << "io_uring が使えないため io_uring の計測を省略します\n";
+    loaders.push_back({"AsyncBmpLoader (thread_pool)", [&](const std::vector<std::string> &list) { pool.run(list, onImage); }});
+
+    std::cout << "ファイル数: " << files.size() << " (キュー深さ " << depth << (classify ? ", 判定あり" : "") << ")\n";
+    printf("%-30s %14s %14s\n", "loader", "cold files/s", "warm files/s");
+    for (const auto &loader : loaders)
+    {
+        double cold = measure(unique, files, repeat, true, loader.second);
+        double warm = measure(unique, files, repeat, false, loader.second);
+        printf("%-30s %14.1f %14.1f\n", loader.first.c_str(), cold, warm);
+    }
+
+    return checksum == 0 ? 1 : 0;
+}
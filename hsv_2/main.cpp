@@ -1,43 +1,196 @@
 #include "hsv_filter.hpp"
+#include "manifest.hpp"
+#include "sequence_counter.hpp"
+#include "shm_ring.hpp"
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <iostream>
 
-struct TestCase
+// 判定に使われている範囲を出力する (色ごとに複数あれば ", " で区切る)
+void printThresholds(const HSVFilter &filter)
 {
-    std::string filename;
-    int actual_apples;
-    int actual_oranges;
-    int actual_persimmons;
-};
+    const char *labels[NUM_FRUIT_COLORS] = {"りんご", "みかん", "へた "};
+    std::cout << "現在の閾値:\n";
+    for (int color = 0; color < NUM_FRUIT_COLORS; color++)
+    {
+        std::cout << labels[color] << " -";
+        const char *separator = " ";
+        for (const auto &range : filter.getRanges(FruitColor(color)))
+        {
+            std::cout << separator << "H:" << range.h_min << "-" << range.h_max
+                      << " S:" << range.s_min << "-" << range.s_max
+                      << " V:" << range.v_min << "-" << range.v_max;
+            separator = ", ";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "\n";
+}
 
-void printThresholds(const FruitThresholds &thresholds)
+// 連番のパターンが整数の変換 (%d, %04d など) をちょうど1つだけ含むか確認する
+// パターンは snprintf の書式としてそのまま使うので、それ以外の変換は受け付けない
+bool isSequencePattern(const std::string &pattern)
 {
-    std::cout << "現在の閾値:\n";
-    std::cout << "りんご - H:" << thresholds.apple.h_min << "-" << thresholds.apple.h_max
-              << " S:" << thresholds.apple.s_min << "-" << thresholds.apple.s_max
-              << " V:" << thresholds.apple.v_min << "-" << thresholds.apple.v_max << "\n";
-    std::cout << "みかん - H:" << thresholds.orange.h_min << "-" << thresholds.orange.h_max
-              << " S:" << thresholds.orange.s_min << "-" << thresholds.orange.s_max
-              << " V:" << thresholds.orange.v_min << "-" << thresholds.orange.v_max << "\n";
-    std::cout << "へた  - H:" << thresholds.stem.h_min << "-" << thresholds.stem.h_max
-              << " S:" << thresholds.stem.s_min << "-" << thresholds.stem.s_max
-              << " V:" << thresholds.stem.v_min << "-" << thresholds.stem.v_max << "\n\n";
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%')
+            continue;
+        i++;
+        if (i < pattern.size() && pattern[i] == '%')
+            continue; // "%%" は '%' そのもの
+
+        // フラグと桁数だけを許す (例: %04d, %-3d)
+        while (i < pattern.size() && std::strchr("0-+ ", pattern[i]))
+            i++;
+        while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i])))
+            i++;
+        if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i'))
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// ファイル全体を buffer に読み込む (領域はフレーム間で使い回す)
+bool readWholeFile(const char *filename, std::vector<unsigned char> &buffer)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return false;
+
+    buffer.clear();
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+// 連番BMP (例: frame_%04d.bmp) を順に処理する
+// ファイルが見つからなくなった時点で終了
+// 画像は展開せず、ファイル内の画素をそのままタイルごとに比べて判定する
+int runSequence(const std::string &pattern, int start)
+{
+    if (!isSequencePattern(pattern))
+    {
+        printf("連番のパターンには %%d (%%04d など) をちょうど1つ含めてください: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    HSVFilter filter;
+    filter.setVerbose(false);
+    SequenceCounter sequence(filter);
+    std::vector<unsigned char> buffer;
+
+    for (int index = start;; index++)
+    {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), pattern.c_str(), index);
+
+        if (!readWholeFile(filename, buffer))
+            break;
+
+        BmpLayout layout;
+        if (!HSVFilter::parseBmp(buffer.data(), buffer.size(), layout))
+        {
+            printf("24ビット無圧縮のBMPではありません: %s\n", filename);
+            break;
+        }
+
+        auto count = sequence.processFrame(layout.bgr, layout.width, layout.height, layout.stride);
+
+        std::cout << filename
+                  << " りんご:" << count.apples
+                  << " みかん:" << count.oranges
+                  << " かき:" << count.persimmons
+                  << " (再判定タイル " << sequence.getChangedTiles()
+                  << "/" << sequence.getTotalTiles() << ")\n";
+    }
+
+    return 0;
 }
 
-int main()
+// 共有メモリのリングバッファからフレームを受け取って処理する
+// 書き込み側 (shm_producer など) が終了を知らせるまで続ける
+int runSharedMemory(const std::string &name)
 {
+    // 書き込み側が後から起動しても良いように、作成されるまで少し待つ
+    ShmFrameRing ring;
+    if (!ring.open(name, 10000))
+        return 1;
+
+    HSVFilter filter;
+    filter.setVerbose(false);
+
+    ShmFrameRing::Frame frame;
+    uint64_t expected = 0;
+    uint64_t missing = 0;
+    while (ring.acquire(frame))
+    {
+        // スロット内のデータをコピーせずにそのまま判定する
+        PixelCounts pixels = filter.countPixelsBgr(frame.bgr, frame.width, frame.height, frame.stride);
+        ring.release();
+
+        // 通し番号が飛んでいれば、その間のフレームは書き込み側で捨てられている
+        missing += frame.sequence - expected;
+        expected = frame.sequence + 1;
+
+        FruitCount count = filter.estimateCount(pixels);
+        std::cout << "フレーム " << frame.sequence
+                  << " りんご:" << count.apples
+                  << " みかん:" << count.oranges
+                  << " かき:" << count.persimmons
+                  << " (欠落 " << missing << ")\n";
+    }
+
+    std::cout << "受信 " << ring.written() << "フレーム中 " << (ring.written() - ring.dropped())
+              << "フレームを処理 (捨てたフレーム " << ring.dropped() << ")\n";
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && std::string(argv[1]) == "--shm")
+    {
+        return runSharedMemory(argv[2]);
+    }
+
+    if (argc >= 3 && std::string(argv[1]) == "--sequence")
+    {
+        int start = 0;
+        if (argc >= 4)
+        {
+            char *end;
+            errno = 0;
+            long value = std::strtol(argv[3], &end, 10);
+            if (end == argv[3] || *end != '\0' || errno == ERANGE || value < 0 || value > INT_MAX)
+            {
+                printf("使用方法: %s --sequence <パターン (例: frame_%%04d.bmp)> [開始番号]\n", argv[0]);
+                return 1;
+            }
+            start = int(value);
+        }
+        return runSequence(argv[2], start);
+    }
+
+    // テストケースはマニフェストから読み込む (引数で別のマニフェストも指定可)
+    std::string manifestPath = (argc >= 2) ? argv[1] : "../images/manifest.txt";
+    std::vector<TestCase> testCases = loadManifest(manifestPath);
+    if (testCases.empty())
+        return 1;
+
     HSVFilter filter;
-    std::vector<TestCase> testCases = {
-        {"/home/temmie0232/Project/seminar/images/L11.bmp", 0, 5, 0},
-        {"/home/temmie0232/Project/seminar/images/L12.bmp", 0, 5, 0},
-        {"/home/temmie0232/Project/seminar/images/L21.bmp", 0, 4, 3},
-        {"/home/temmie0232/Project/seminar/images/L22.bmp", 2, 3, 3},
-        {"/home/temmie0232/Project/seminar/images/L31.bmp", 2, 4, 2},
-        {"/home/temmie0232/Project/seminar/images/L32.bmp", 3, 5, 3},
-    };
     // 現在の閾値を出力
-    printThresholds(filter.getThresholds());
+    printThresholds(filter);
 
     // 各テストケースを実行
     for (const auto &test : testCases)
@@ -0,0 +1,38 @@
+#include "manifest.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+std::vector<TestCase> loadManifest(const std::string &path)
+{
+    std::vector<TestCase> entries;
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "マニフェストを開けませんでした: " << path << "\n";
+        return entries;
+    }
+
+    std::string dir;
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos)
+        dir = path.substr(0, slash + 1);
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream in(line);
+        TestCase entry = {"", -1, -1, -1};
+        if (!(in >> entry.filename))
+            continue;
+        in >> entry.actual_apples >> entry.actual_oranges >> entry.actual_persimmons;
+        if (entry.filename[0] != '/')
+            entry.filename = dir + entry.filename;
+        entries.push_back(entry);
+    }
+    return entries;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// 画像と正解の果物の数
+struct TestCase
+{
+    std::string filename;
+    int actual_apples;
+    int actual_oranges;
+    int actual_persimmons;
+};
+
+// マニフェストを読み込む (相対パスはマニフェストのあるディレクトリ基準)
+// 形式: ファイル名 りんご みかん かき  (# 以降はコメント, 正解がない場合は -1)
+std::vector<TestCase> loadManifest(const std::string &path);
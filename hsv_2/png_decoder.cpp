@@ -0,0 +1,533 @@
+#include "png_decoder.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    uint32_t readBE32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    // ------------------------------------------------------------
+    // 伸張結果を受け取り、1行分たまるごとにフィルタを戻してRGBへ変換する
+    // ------------------------------------------------------------
+    class ScanlineSink
+    {
+    public:
+        ScanlineSink(const PngInfo &info, const std::vector<RGB> &palette, const PngRowCallback &onRow)
+            : info(info), palette(palette), onRow(onRow)
+        {
+            switch (info.color_type)
+            {
+            case 0: channels = 1; break;
+            case 2: channels = 3; break;
+            case 3: channels = 1; break;
+            case 4: channels = 2; break;
+            case 6: channels = 4; break;
+            default: throw std::runtime_error("Unsupported PNG color type");
+            }
+            rowBytes = size_t(info.width) * channels;
+            if (rowBytes > MAX_ROW_BYTES)
+                throw std::runtime_error("PNG image is too wide");
+            cur.assign(rowBytes + 1, 0);
+            prev.assign(rowBytes, 0);
+            rgb.resize(info.width);
+        }
+
+        void put(uint8_t byte)
+        {
+            cur[pos++] = byte;
+            if (pos == cur.size())
+                flushRow();
+        }
+
+        bool complete() const { return y == info.height; }
+
+    private:
+        // 壊れたヘッダで巨大な行バッファを確保しないための上限 (64MB)
+        static const size_t MAX_ROW_BYTES = size_t(1) << 26;
+
+        const PngInfo &info;
+        const std::vector<RGB> &palette;
+        const PngRowCallback &onRow;
+        size_t channels = 0;
+        size_t rowBytes = 0;
+        std::vector<uint8_t> cur;  // 先頭1バイトはフィルタ種別
+        std::vector<uint8_t> prev; // フィルタを戻した前の行
+        std::vector<RGB> rgb;
+        size_t pos = 0;
+        uint32_t y = 0;
+
+        static uint8_t paeth(int a, int b, int c)
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a);
+            int pb = std::abs(p - b);
+            int pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc)
+                return uint8_t(a);
+            if (pb <= pc)
+                return uint8_t(b);
+            return uint8_t(c);
+        }
+
+        void flushRow()
+        {
+            if (y >= info.height)
+                throw std::runtime_error("PNG has too much image data");
+
+            uint8_t filter = cur[0];
+            uint8_t *row = cur.data() + 1;
+            const uint8_t *up = prev.data();
+            size_t bpp = channels;
+
+            switch (filter)
+            {
+            case 0: // None
+                break;
+            case 1: // Sub
+                for (size_t i = bpp; i < rowBytes; i++)
+                    row[i] = uint8_t(row[i] + row[i - bpp]);
+                break;
+            case 2: // Up
+                for (size_t i = 0; i < rowBytes; i++)
+                    row[i] = uint8_t(row[i] + up[i]);
+                break;
+            case 3: // Average
+                for (size_t i = 0; i < rowBytes; i++)
+                {
+                    int left = (i >= bpp) ? row[i - bpp] : 0;
+                    row[i] = uint8_t(row[i] + ((left + up[i]) >> 1));
+                }
+                break;
+            case 4: // Paeth
+                for (size_t i = 0; i < rowBytes; i++)
+                {
+                    int left = (i >= bpp) ? row[i - bpp] : 0;
+                    int upLeft = (i >= bpp) ? up[i - bpp] : 0;
+                    row[i] = uint8_t(row[i] + paeth(left, up[i], upLeft));
+                }
+                break;
+            default:
+                throw std::runtime_error("Invalid PNG filter type");
+            }
+
+            // RGBへ変換 (αチャンネルは imread(IMREAD_COLOR) と同様に捨てる)
+            for (uint32_t x = 0; x < info.width; x++)
+            {
+                const uint8_t *px = row + x * channels;
+                switch (info.color_type)
+                {
+                case 0:
+                case 4:
+                    rgb[x] = {px[0], px[0], px[0]};
+                    break;
+                case 3:
+                    if (px[0] >= palette.size())
+                        throw std::runtime_error("PNG palette index out of range");
+                    rgb[x] = palette[px[0]];
+                    break;
+                default:
+                    rgb[x] = {px[0], px[1], px[2]};
+                    break;
+                }
+            }
+            onRow(y, rgb.data(), info.width);
+
+            std::memcpy(prev.data(), row, rowBytes);
+            pos = 0;
+            y++;
+        }
+    };
+
+    // ------------------------------------------------------------
+    // Deflate (RFC 1951) の伸張
+    // ------------------------------------------------------------
+    const int MAX_BITS = 15;
+    const int FAST_BITS = 10;
+
+    struct Huffman
+    {
+        uint16_t counts[MAX_BITS + 1];
+        uint16_t symbols[288];
+        uint16_t fast[1 << FAST_BITS]; // (符号長 << 9) | シンボル, 0 は未登録
+
+        void build(const uint8_t *lengths, int n)
+        {
+            std::memset(counts, 0, sizeof(counts));
+            std::memset(fast, 0, sizeof(fast));
+            for (int i = 0; i < n; i++)
+                counts[lengths[i]]++;
+            counts[0] = 0;
+
+            uint16_t offsets[MAX_BITS + 2];
+            offsets[1] = 0;
+            for (int len = 1; len <= MAX_BITS; len++)
+                offsets[len + 1] = uint16_t(offsets[len] + counts[len]);
+            for (int i = 0; i < n; i++)
+                if (lengths[i] != 0)
+                    symbols[offsets[lengths[i]]++] = uint16_t(i);
+
+            // 短い符号はビット反転した値で直接引けるようにしておく
+            int code = 0;
+            int next[MAX_BITS + 1];
+            for (int len = 1; len <= MAX_BITS; len++)
+            {
+                code = (code + counts[len - 1]) << 1;
+                next[len] = code;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                int len = lengths[i];
+                if (len == 0 || len > FAST_BITS)
+                    continue;
+                int c = next[len]++;
+                int rev = 0;
+                for (int b = 0; b < len; b++)
+                    rev |= ((c >> b) & 1) << (len - 1 - b);
+                for (int j = rev; j < (1 << FAST_BITS); j += (1 << len))
+                    fast[j] = uint16_t((len << 9) | i);
+            }
+        }
+    };
+
+    class Inflater
+    {
+    public:
+        Inflater(const std::vector<uint8_t> &data, ScanlineSink &sink)
+            : data(data), sink(sink), window(WINDOW_SIZE) {}
+
+        void run()
+        {
+            // zlibヘッダ (CMF, FLG)
+            if (data.size() < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0)
+                throw std::runtime_error("Invalid zlib stream in PNG");
+            if (data[1] & 0x20)
+                throw std::runtime_error("Preset dictionary is not supported");
+            pos = 2;
+
+            int last;
+            do
+            {
+                last = getBits(1);
+                int type = getBits(2);
+                if (type == 0)
+                    stored();
+                else if (type == 1)
+                    fixed();
+                else if (type == 2)
+                    dynamic();
+                else
+                    throw std::runtime_error("Invalid deflate block type");
+            } while (!last && !sink.complete());
+        }
+
+    private:
+        static const size_t WINDOW_SIZE = 32768;
+
+        const std::vector<uint8_t> &data;
+        ScanlineSink &sink;
+        std::vector<uint8_t> window; // 後方参照用のスライド窓
+        size_t wpos = 0;
+        size_t pos = 0;
+        uint32_t bitBuf = 0;
+        int bitCount = 0;
+
+        void need(int n)
+        {
+            while (bitCount < n)
+            {
+                // 末尾を越えた分は0で埋める (実際に消費すればエラー)
+                if (pos > data.size() + 4)
+                    throw std::runtime_error("Unexpected end of PNG data");
+                uint32_t byte = (pos < data.size()) ? data[pos] : 0;
+                pos++;
+                bitBuf |= byte << bitCount;
+                bitCount += 8;
+            }
+        }
+
+        // 消費したビットが実際のデータを越えていればエラー
+        // (途中で切れたデータの0埋めを符号として出力しないよう、消費するたびに確認する)
+        void consume(int n)
+        {
+            bitBuf >>= n;
+            bitCount -= n;
+            if (pos * 8 - size_t(bitCount) > data.size() * 8)
+                throw std::runtime_error("Unexpected end of PNG data");
+        }
+
+        int getBits(int n)
+        {
+            need(n);
+            int v = int(bitBuf & ((1u << n) - 1));
+            consume(n);
+            return v;
+        }
+
+        void output(uint8_t byte)
+        {
+            window[wpos] = byte;
+            wpos = (wpos + 1) & (WINDOW_SIZE - 1);
+            sink.put(byte);
+        }
+
+        int decodeSymbol(const Huffman &h)
+        {
+            need(FAST_BITS);
+            uint16_t e = h.fast[bitBuf & ((1u << FAST_BITS) - 1)];
+            if (e != 0)
+            {
+                consume(e >> 9);
+                return e & 0x1FF;
+            }
+
+            // 長い符号は1ビットずつ辿る
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len <= MAX_BITS; len++)
+            {
+                code |= getBits(1);
+                int count = h.counts[len];
+                if (code - count < first)
+                    return h.symbols[index + (code - first)];
+                index += count;
+                first += count;
+                first <<= 1;
+                code <<= 1;
+            }
+            throw std::runtime_error("Invalid Huffman code in PNG");
+        }
+
+        void stored()
+        {
+            // バイト境界にそろえる
+            bitBuf >>= (bitCount & 7);
+            bitCount -= (bitCount & 7);
+            int len = getBits(16);
+            int nlen = getBits(16);
+            if ((len ^ 0xFFFF) != nlen)
+                throw std::runtime_error("Corrupt stored block in PNG");
+            // ビットバッファに残ったバイトを先に使う
+            while (len > 0 && bitCount >= 8)
+            {
+                output(uint8_t(getBits(8)));
+                len--;
+            }
+            if (pos + size_t(len) > data.size())
+                throw std::runtime_error("Unexpected end of PNG data");
+            for (; len > 0; len--)
+                output(data[pos++]);
+        }
+
+        void codes(const Huffman &lit, const Huffman &dist)
+        {
+            static const uint16_t lenBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const uint8_t lenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            static const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                                  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                                  6145, 8193, 12289, 16385, 24577};
+            static const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+            for (;;)
+            {
+                int sym = decodeSymbol(lit);
+                if (sym < 256)
+                {
+                    output(uint8_t(sym));
+                }
+                else if (sym == 256)
+                {
+                    return;
+                }
+                else
+                {
+                    sym -= 257;
+                    if (sym >= 29)
+                        throw std::runtime_error("Invalid length code in PNG");
+                    int len = lenBase[sym] + getBits(lenExtra[sym]);
+                    int dsym = decodeSymbol(dist);
+                    if (dsym >= 30)
+                        throw std::runtime_error("Invalid distance code in PNG");
+                    size_t d = distBase[dsym] + getBits(distExtra[dsym]);
+                    size_t from = (wpos - d) & (WINDOW_SIZE - 1);
+                    for (int i = 0; i < len; i++)
+                    {
+                        output(window[from]);
+                        from = (from + 1) & (WINDOW_SIZE - 1);
+                    }
+                }
+            }
+        }
+
+        struct FixedTables
+        {
+            Huffman lit, dist;
+            FixedTables()
+            {
+                uint8_t lengths[288];
+                int i = 0;
+                for (; i < 144; i++)
+                    lengths[i] = 8;
+                for (; i < 256; i++)
+                    lengths[i] = 9;
+                for (; i < 280; i++)
+                    lengths[i] = 7;
+                for (; i < 288; i++)
+                    lengths[i] = 8;
+                lit.build(lengths, 288);
+                for (i = 0; i < 30; i++)
+                    lengths[i] = 5;
+                dist.build(lengths, 30);
+            }
+        };
+
+        void fixed()
+        {
+            static const FixedTables tables;
+            codes(tables.lit, tables.dist);
+        }
+
+        void dynamic()
+        {
+            static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+            int nlen = getBits(5) + 257;
+            int ndist = getBits(5) + 1;
+            int ncode = getBits(4) + 4;
+            if (nlen > 286 || ndist > 30)
+                throw std::runtime_error("Invalid dynamic block in PNG");
+
+            uint8_t lengths[320] = {0};
+            for (int i = 0; i < ncode; i++)
+                lengths[order[i]] = uint8_t(getBits(3));
+            Huffman lencode;
+            lencode.build(lengths, 19);
+
+            int index = 0;
+            while (index < nlen + ndist)
+            {
+                int sym = decodeSymbol(lencode);
+                if (sym < 16)
+                {
+                    lengths[index++] = uint8_t(sym);
+                    continue;
+                }
+                uint8_t value = 0;
+                int repeat;
+                if (sym == 16)
+                {
+                    if (index == 0)
+                        throw std::runtime_error("Invalid code length repeat in PNG");
+                    value = lengths[index - 1];
+                    repeat = 3 + getBits(2);
+                }
+                else if (sym == 17)
+                {
+                    repeat = 3 + getBits(3);
+                }
+                else
+                {
+                    repeat = 11 + getBits(7);
+                }
+                if (index + repeat > nlen + ndist)
+                    throw std::runtime_error("Too many code lengths in PNG");
+                while (repeat--)
+                    lengths[index++] = value;
+            }
+
+            Huffman lit, dist;
+            lit.build(lengths, nlen);
+            dist.build(lengths + nlen, ndist);
+            codes(lit, dist);
+        }
+    };
+}
+
+PngInfo PngDecoder::decode(const std::string &filename, const PngRowCallback &onRow)
+{
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        throw std::runtime_error("Cannot open file: " + filename);
+
+    std::vector<uint8_t> file;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size > 0)
+    {
+        file.resize(size_t(size));
+        if (fread(file.data(), 1, file.size(), fp) != file.size())
+            file.clear();
+    }
+    fclose(fp);
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0)
+        throw std::runtime_error("Not a PNG file: " + filename);
+
+    // チャンクを走査してIHDR/PLTEを取り出し、IDATを連結する
+    // (圧縮データは小さいので連結し、伸張後のデータは1行ずつしか保持しない)
+    PngInfo info = {0, 0, 0, 0};
+    std::vector<RGB> palette;
+    std::vector<uint8_t> idat;
+    bool haveHeader = false;
+    size_t p = 8;
+    while (p + 12 <= file.size())
+    {
+        uint32_t length = readBE32(&file[p]);
+        const uint8_t *type = &file[p + 4];
+        const uint8_t *body = &file[p + 8];
+        if (length > file.size() - p - 12)
+            throw std::runtime_error("Truncated PNG chunk");
+
+        if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13)
+        {
+            info.width = readBE32(body);
+            info.height = readBE32(body + 4);
+            info.bit_depth = body[8];
+            info.color_type = body[9];
+            if (body[10] != 0 || body[11] != 0)
+                throw std::runtime_error("Unsupported PNG compression/filter method");
+            if (body[12] != 0)
+                throw std::runtime_error("Interlaced PNG files are not supported");
+            if (info.bit_depth != 8)
+                throw std::runtime_error("Only 8-bit PNG files are supported");
+            // 仕様上、幅と高さは 2^31-1 以下
+            if (info.width > 0x7FFFFFFFu || info.height > 0x7FFFFFFFu)
+                throw std::runtime_error("PNG image size is out of range");
+            haveHeader = true;
+        }
+        else if (std::memcmp(type, "PLTE", 4) == 0)
+        {
+            for (uint32_t i = 0; i + 2 < length; i += 3)
+                palette.push_back({body[i], body[i + 1], body[i + 2]});
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0)
+        {
+            idat.insert(idat.end(), body, body + length);
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        p += 12 + length;
+    }
+
+    if (!haveHeader || info.width == 0 || info.height == 0)
+        throw std::runtime_error("Missing PNG header");
+
+    ScanlineSink sink(info, palette, onRow);
+    Inflater inflater(idat, sink);
+    inflater.run();
+    if (!sink.complete())
+        throw std::runtime_error("PNG image data is incomplete");
+
+    return info;
+}
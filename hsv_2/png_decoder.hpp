@@ -0,0 +1,27 @@
+#pragma once
+#include "hsv_filter.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// PNG画像の基本情報
+struct PngInfo
+{
+    uint32_t width;
+    uint32_t height;
+    uint8_t bit_depth;  // 8ビットのみ対応
+    uint8_t color_type; // 0:グレー 2:RGB 3:パレット 4:グレー+α 6:RGBA
+};
+
+// 1行デコードされるたびに呼ばれるコールバック (y: 上からの行番号)
+using PngRowCallback = std::function<void(uint32_t y, const RGB *row, uint32_t width)>;
+
+// OpenCVを使わないPNGデコーダ
+// IDATを伸張しながら1行ずつフィルタを戻してコールバックへ渡すため、
+// 画像全体の展開を待たずに判定処理を始められる
+class PngDecoder
+{
+public:
+    // ファイルを読み込み、各行をコールバックに渡す (失敗時は std::runtime_error)
+    static PngInfo decode(const std::string &filename, const PngRowCallback &onRow);
+};
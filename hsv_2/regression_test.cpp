@@ -0,0 +1,448 @@
+// 回帰テスト・ベンチマーク
+// 画像ディレクトリ内の画像について、検出数・色ごとのピクセル数・色分け画像を
+// 期待値 (golden.txt) と比較し、処理速度が基準値より落ちていないかも確認する
+// 色分け画像は golden/ に保存した「ピクセルごとの判定結果」(ランレングス圧縮) から
+// 期待画像を作り直し、1ピクセルずつ比較する (異なる場合は差分画像を出力する)
+// 1つでも一致しなければ終了コード1を返す
+//
+// 使い方: ./regression_test [--update] [--images DIR] [--out DIR] [--golden-dir DIR]
+//                           [--baseline FILE] [--max-slowdown PCT] [--iterations N] [--no-perf-gate]
+#include "hsv_filter.hpp"
+#include "manifest.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+struct GoldenEntry
+{
+    FruitCount count;
+    PixelCounts pixels;
+    size_t bmpSize;
+    uint64_t bmpHash;
+};
+
+bool hasExtension(const std::string &name, const std::string &ext)
+{
+    return name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// ディレクトリ内のBMP/PNGを名前順に列挙する
+std::vector<std::string> discoverImages(const std::string &dir)
+{
+    std::vector<std::string> names;
+    DIR *dp = opendir(dir.c_str());
+    if (!dp)
+        return names;
+    while (dirent *entry = readdir(dp))
+    {
+        std::string name = entry->d_name;
+        if (hasExtension(name, ".bmp") || hasExtension(name, ".png"))
+            names.push_back(name);
+    }
+    closedir(dp);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+uint64_t fnv1a64(const std::string &data)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// 色分け画像の各ピクセルが何色で塗られたか (0: 塗られていない, 1: りんご, 2: みかん, 3: へた)
+const RGB MASK_COLORS[4] = {{0, 0, 0}, {0, 255, 0}, {255, 0, 0}, {0, 0, 255}};
+
+bool sameColor(const RGB &a, const RGB &b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+std::vector<uint8_t> toMask(const std::vector<std::vector<RGB>> &annotated)
+{
+    std::vector<uint8_t> mask;
+    for (const auto &row : annotated)
+    {
+        for (const auto &pixel : row)
+        {
+            uint8_t label = 0;
+            for (uint8_t c = 1; c < 4; c++)
+                if (sameColor(pixel, MASK_COLORS[c]))
+                    label = c;
+            mask.push_back(label);
+        }
+    }
+    return mask;
+}
+
+// 判定結果ファイルの形式
+//   "MSK1", 幅 (uint32), 高さ (uint32), (色 (1 byte), 連続するピクセル数 (可変長整数)) の繰り返し
+// 同じ色が続く部分をまとめるので、色分け画像そのものより2桁ほど小さい
+std::string encodeMask(const std::vector<uint8_t> &mask, uint32_t width, uint32_t height)
+{
+    std::string out = "MSK1";
+    out.append(reinterpret_cast<const char *>(&width), 4);
+    out.append(reinterpret_cast<const char *>(&height), 4);
+    for (size_t i = 0; i < mask.size();)
+    {
+        size_t run = 1;
+        while (i + run < mask.size() && mask[i + run] == mask[i])
+            run++;
+        out.push_back(char(mask[i]));
+        for (size_t n = run; ; n >>= 7)
+        {
+            if (n < 0x80)
+            {
+                out.push_back(char(n));
+                break;
+            }
+            out.push_back(char((n & 0x7F) | 0x80));
+        }
+        i += run;
+    }
+    return out;
+}
+
+bool decodeMask(const std::string &data, std::vector<uint8_t> &mask, uint32_t &width, uint32_t &height)
+{
+    if (data.size() < 12 || data.compare(0, 4, "MSK1") != 0)
+        return false;
+    std::memcpy(&width, &data[4], 4);
+    std::memcpy(&height, &data[8], 4);
+    uint64_t total = uint64_t(width) * height;
+
+    mask.clear();
+    size_t p = 12;
+    while (p < data.size())
+    {
+        uint8_t label = uint8_t(data[p++]);
+        uint64_t run = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (p >= data.size() || shift > 35)
+                return false;
+            uint8_t byte = uint8_t(data[p++]);
+            run |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        if (label > 3 || mask.size() + run > total)
+            return false;
+        mask.insert(mask.end(), size_t(run), label);
+    }
+    return mask.size() == total;
+}
+
+// 形式: ファイル名 りんご みかん かき りんご色px みかん色px へたpx 色分けBMPのサイズ ハッシュ(16進)
+std::map<std::string, GoldenEntry> loadGolden(const std::string &path)
+{
+    std::map<std::string, GoldenEntry> golden;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream in(line);
+        std::string name;
+        GoldenEntry entry;
+        if (in >> name >> entry.count.apples >> entry.count.oranges >> entry.count.persimmons >> entry.pixels.apple >> entry.pixels.orange >> entry.pixels.stem >> entry.bmpSize >> std::hex >> entry.bmpHash)
+            golden[name] = entry;
+    }
+    return golden;
+}
+
+bool saveGolden(const std::string &path, const std::map<std::string, GoldenEntry> &golden)
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    file << "# ファイル名 りんご みかん かき りんご色px みかん色px へたpx 色分けBMPのサイズ ハッシュ\n";
+    for (const auto &item : golden)
+    {
+        const GoldenEntry &e = item.second;
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)e.bmpHash);
+        file << item.first << " " << e.count.apples << " " << e.count.oranges << " " << e.count.persimmons
+             << " " << e.pixels.apple << " " << e.pixels.orange << " " << e.pixels.stem
+             << " " << e.bmpSize << " " << hash << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    bool update = false;
+    bool perfGate = true;
+    std::string imageDir = "../images";
+    std::string outDir = "regression_out";
+    std::string goldenDir;
+    std::string baselinePath = "perf_baseline.txt";
+    double maxSlowdown = 10.0;
+    int iterations = 3;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--update")
+            update = true;
+        else if (arg == "--images" && hasValue)
+            imageDir = argv[++i];
+        else if (arg == "--out" && hasValue)
+            outDir = argv[++i];
+        else if (arg == "--golden-dir" && hasValue)
+            goldenDir = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            baselinePath = argv[++i];
+        else if (arg == "--max-slowdown" && hasValue)
+            maxSlowdown = std::stod(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            iterations = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--no-perf-gate")
+            perfGate = false;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--update] [--images DIR] [--out DIR] [--golden-dir DIR]"
+                      << " [--baseline FILE] [--max-slowdown PCT] [--iterations N] [--no-perf-gate]\n";
+            return 1;
+        }
+    }
+
+    std::vector<std::string> names = discoverImages(imageDir);
+    if (names.empty())
+    {
+        std::cerr << "画像が見つかりません: " << imageDir << "\n";
+        return 1;
+    }
+
+    // 正解の数 (あれば精度も表示する)
+    std::map<std::string, TestCase> truth;
+    for (const auto &test : loadManifest(imageDir + "/manifest.txt"))
+        truth[test.filename] = test;
+
+    std::string goldenPath = imageDir + "/golden.txt";
+    // 期待画像は画像ディレクトリの golden/ にある
+    if (goldenDir.empty())
+        goldenDir = imageDir + "/golden";
+    std::map<std::string, GoldenEntry> golden = loadGolden(goldenPath);
+    std::map<std::string, GoldenEntry> current;
+
+    mkdir(outDir.c_str(), 0755);
+    if (update)
+        mkdir(goldenDir.c_str(), 0755);
+
+    HSVFilter filter;
+    filter.setVerbose(false);
+
+    int failures = 0;
+    std::vector<std::vector<std::vector<RGB>>> images;
+
+    for (const auto &name : names)
+    {
+        std::string path = imageDir + "/" + name;
+        auto image = hasExtension(name, ".png") ? filter.loadPngImage(path) : filter.loadBmpImage(path);
+        if (image.empty())
+        {
+            std::cout << "[FAIL] " << name << ": 読み込めませんでした\n";
+            failures++;
+            continue;
+        }
+
+        GoldenEntry entry;
+        entry.pixels = filter.countPixels(image);
+        entry.count = filter.estimateCount(entry.pixels);
+
+        std::string annotatedPath = outDir + "/" + name + ".bmp";
+        auto annotatedImage = filter.annotate(image);
+        filter.saveBmpImage(annotatedImage, annotatedPath);
+        std::string annotated = readFile(annotatedPath);
+        entry.bmpSize = annotated.size();
+        entry.bmpHash = fnv1a64(annotated);
+        current[name] = entry;
+        images.push_back(std::move(image));
+        const auto &source = images.back();
+
+        auto t = truth.find(path);
+        if (t != truth.end() && t->second.actual_apples >= 0)
+        {
+            std::cout << "       " << name << " 誤差 - りんご:" << (entry.count.apples - t->second.actual_apples)
+                      << " みかん:" << (entry.count.oranges - t->second.actual_oranges)
+                      << " かき:" << (entry.count.persimmons - t->second.actual_persimmons) << "\n";
+        }
+
+        uint32_t width = uint32_t(source[0].size());
+        uint32_t height = uint32_t(source.size());
+        std::string maskPath = goldenDir + "/" + name + ".mask";
+        if (update)
+        {
+            std::ofstream(maskPath, std::ios::binary) << encodeMask(toMask(annotatedImage), width, height);
+            continue;
+        }
+
+        auto g = golden.find(name);
+        if (g == golden.end())
+        {
+            std::cout << "[FAIL] " << name << ": 期待値がありません (--update で作成)\n";
+            failures++;
+            continue;
+        }
+
+        const GoldenEntry &e = g->second;
+        bool ok = true;
+        if (entry.count.apples != e.count.apples || entry.count.oranges != e.count.oranges || entry.count.persimmons != e.count.persimmons)
+        {
+            std::cout << "[FAIL] " << name << ": 検出数 " << entry.count.apples << "/" << entry.count.oranges << "/" << entry.count.persimmons
+                      << " (期待値 " << e.count.apples << "/" << e.count.oranges << "/" << e.count.persimmons << ")\n";
+            ok = false;
+        }
+        if (entry.pixels.apple != e.pixels.apple || entry.pixels.orange != e.pixels.orange || entry.pixels.stem != e.pixels.stem)
+        {
+            std::cout << "[FAIL] " << name << ": ピクセル数 " << entry.pixels.apple << "/" << entry.pixels.orange << "/" << entry.pixels.stem
+                      << " (期待値 " << e.pixels.apple << "/" << e.pixels.orange << "/" << e.pixels.stem << ")\n";
+            ok = false;
+        }
+
+        // 色分け画像の比較
+        // 元画像と判定結果ファイルから期待画像を作り、1ピクセルずつ比較する
+        // (BMPのヘッダも含めたファイル全体は golden.txt のサイズとハッシュで比較する)
+        std::vector<uint8_t> mask;
+        uint32_t maskWidth = 0, maskHeight = 0;
+        if (!decodeMask(readFile(maskPath), mask, maskWidth, maskHeight))
+        {
+            std::cout << "[FAIL] " << name << ": 判定結果ファイルがないか壊れています: " << maskPath << " (--update で作成)\n";
+            ok = false;
+        }
+        else if (maskWidth != width || maskHeight != height)
+        {
+            std::cout << "[FAIL] " << name << ": 画像サイズ " << width << "x" << height
+                      << " (期待値 " << maskWidth << "x" << maskHeight << ")\n";
+            ok = false;
+        }
+        else
+        {
+            // 異なるピクセルを白、それ以外を暗くした差分画像を作る
+            std::vector<std::vector<RGB>> diff = annotatedImage;
+            size_t mismatches = 0, first = 0;
+            for (uint32_t y = 0; y < height; y++)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    uint8_t label = mask[size_t(y) * width + x];
+                    const RGB &expected = label ? MASK_COLORS[label] : source[y][x];
+                    RGB &pixel = diff[y][x];
+                    if (!sameColor(expected, annotatedImage[y][x]))
+                    {
+                        if (mismatches++ == 0)
+                            first = size_t(y) * width + x;
+                        pixel = {255, 255, 255};
+                    }
+                    else
+                    {
+                        pixel = {uint8_t(pixel.r / 4), uint8_t(pixel.g / 4), uint8_t(pixel.b / 4)};
+                    }
+                }
+            }
+            if (mismatches > 0)
+            {
+                std::string diffPath = outDir + "/" + name + ".diff.bmp";
+                filter.saveBmpImage(diff, diffPath);
+                std::cout << "[FAIL] " << name << ": 色分け画像の " << mismatches << " ピクセルが異なります (最初は x="
+                          << first % width << " y=" << first / width << ", 差分画像: " << diffPath << ")\n";
+                ok = false;
+            }
+        }
+        if (entry.bmpSize != e.bmpSize || entry.bmpHash != e.bmpHash)
+        {
+            std::cout << "[FAIL] " << name << ": 色分け画像が期待値と異なります (" << annotatedPath << ")\n";
+            ok = false;
+        }
+
+        if (ok)
+            std::cout << "[ OK ] " << name << "\n";
+        else
+            failures++;
+    }
+
+    // 処理速度の計測 (読み込みを除いた判定処理のみ, 最速の回を採用)
+    double pixels = 0;
+    for (const auto &image : images)
+        pixels += double(image.size()) * image[0].size();
+
+    double best = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto &image : images)
+            filter.countPixels(image);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, pixels / 1e6 / seconds);
+    }
+    std::cout << "\n処理速度: " << best << " Mpx/s\n";
+
+    if (update)
+    {
+        if (!saveGolden(goldenPath, current))
+        {
+            std::cerr << "期待値を保存できませんでした: " << goldenPath << "\n";
+            return 1;
+        }
+        std::ofstream(baselinePath) << best << "\n";
+        std::cout << "期待値を更新しました: " << goldenPath << ", " << baselinePath << "\n";
+        return failures > 0 ? 1 : 0;
+    }
+
+    double baseline = 0;
+    std::ifstream baselineFile(baselinePath);
+    if (baselineFile >> baseline && baseline > 0)
+    {
+        double limit = baseline * (1.0 - maxSlowdown / 100.0);
+        std::cout << "基準値: " << baseline << " Mpx/s (許容下限 " << limit << " Mpx/s)\n";
+        if (best < limit)
+        {
+            std::cout << "[FAIL] 処理速度が基準値より " << (100.0 * (1.0 - best / baseline)) << "% 低下しました\n";
+            failures++;
+        }
+    }
+    else if (perfGate)
+    {
+        // 基準値がないまま成功にすると速度の確認が黙って無効になるので、失敗とする
+        std::cout << "[FAIL] 速度の基準値がありません: " << baselinePath
+                  << " (--update で作成, 速度を確認しない場合は --no-perf-gate)\n";
+        failures++;
+    }
+    else
+    {
+        std::cout << "速度の確認を省略しました (--no-perf-gate)\n";
+    }
+
+    if (failures > 0)
+    {
+        std::cout << "\n失敗: " << failures << "件\n";
+        return 1;
+    }
+    std::cout << "\nすべて成功\n";
+    return 0;
+}
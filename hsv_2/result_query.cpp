@@ -0,0 +1,133 @@
+// 列指向の結果ファイル (result_store.hpp) を集計するツール
+// 集計に必要な列だけを読むので、画像数が多くても軽い
+//
+// 使い方: ./result_query [--csv] 結果ファイル...
+//   --csv: 画像ごとの結果をCSVで出力する
+#include "result_store.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// CSVの1項目として引用符で囲む (中の " は "" にする)
+// ファイル名にはカンマや改行が含まれることがあるので、常に囲む
+std::string csvField(const std::string &value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+int main(int argc, char *argv[])
+{
+    bool csv = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--csv")
+            csv = true;
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [--csv] results.col...\n";
+        return 1;
+    }
+
+    if (csv)
+        printf("image_id,name,apple_px,orange_px,stem_px,apples,oranges,persimmons,load_us,classify_us\n");
+
+    size_t images = 0;
+    unsigned long long pixels[3] = {0, 0, 0};
+    unsigned long long fruits[3] = {0, 0, 0};
+    unsigned long long loadUs = 0, classifyUs = 0;
+    uint32_t maxClassifyUs = 0;
+    size_t blobs[NUM_FRUIT_COLORS] = {0, 0, 0};
+    unsigned long long blobArea[NUM_FRUIT_COLORS] = {0, 0, 0};
+
+    for (const auto &file : files)
+    {
+        ResultReader reader;
+        if (!reader.open(file))
+            continue;
+
+        // 集計に使う列だけを読む
+        auto applePx = reader.readUInt(IMAGE_TABLE, IMAGE_APPLE_PX);
+        auto orangePx = reader.readUInt(IMAGE_TABLE, IMAGE_ORANGE_PX);
+        auto stemPx = reader.readUInt(IMAGE_TABLE, IMAGE_STEM_PX);
+        auto apples = reader.readUInt(IMAGE_TABLE, IMAGE_APPLES);
+        auto oranges = reader.readUInt(IMAGE_TABLE, IMAGE_ORANGES);
+        auto persimmons = reader.readUInt(IMAGE_TABLE, IMAGE_PERSIMMONS);
+        auto load = reader.readUInt(IMAGE_TABLE, IMAGE_LOAD_US);
+        auto classify = reader.readUInt(IMAGE_TABLE, IMAGE_CLASSIFY_US);
+
+        size_t n = applePx.size();
+        images += n;
+        for (size_t i = 0; i < n; i++)
+        {
+            pixels[0] += applePx[i];
+            pixels[1] += orangePx[i];
+            pixels[2] += stemPx[i];
+            fruits[0] += apples[i];
+            fruits[1] += oranges[i];
+            fruits[2] += persimmons[i];
+            loadUs += load[i];
+            classifyUs += classify[i];
+            maxClassifyUs = std::max(maxClassifyUs, classify[i]);
+        }
+
+        auto blobColor = reader.readUInt(BLOB_TABLE, BLOB_COLOR);
+        auto area = reader.readUInt(BLOB_TABLE, BLOB_AREA);
+        for (size_t i = 0; i < blobColor.size(); i++)
+        {
+            if (blobColor[i] < NUM_FRUIT_COLORS)
+            {
+                blobs[blobColor[i]]++;
+                blobArea[blobColor[i]] += area[i];
+            }
+        }
+
+        if (csv)
+        {
+            std::map<uint32_t, std::string> names;
+            for (const auto &name : reader.readNames())
+                names[name.first] = name.second;
+            auto ids = reader.readUInt(IMAGE_TABLE, IMAGE_ID);
+            for (size_t i = 0; i < n; i++)
+            {
+                printf("%u,%s,%u,%u,%u,%u,%u,%u,%u,%u\n", ids[i], csvField(names[ids[i]]).c_str(),
+                       applePx[i], orangePx[i], stemPx[i], apples[i], oranges[i], persimmons[i], load[i], classify[i]);
+            }
+        }
+    }
+
+    if (csv)
+        return 0;
+
+    const char *labels[3] = {"りんご", "みかん", "かき"};
+    const char *colorLabels[NUM_FRUIT_COLORS] = {"りんご色", "みかん色", "へた"};
+    printf("画像数: %zu\n", images);
+    for (int c = 0; c < 3; c++)
+        printf("%s: 合計 %llu個 / %s ピクセル数 合計 %llu\n", labels[c], fruits[c], colorLabels[c], pixels[c]);
+    if (images > 0)
+    {
+        printf("読み込み時間 平均: %.1f us\n", double(loadUs) / images);
+        printf("判定時間     平均: %.1f us (最大 %u us)\n", double(classifyUs) / images, maxClassifyUs);
+    }
+    for (int c = 0; c < NUM_FRUIT_COLORS; c++)
+    {
+        if (blobs[c] > 0)
+            printf("%s の塊: %zu個 (平均面積 %.1f px)\n", colorLabels[c], blobs[c], double(blobArea[c]) / blobs[c]);
+    }
+    return 0;
+}
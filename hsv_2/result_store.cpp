@@ -0,0 +1,367 @@
+#include "result_store.hpp"
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+namespace
+{
+    const char BLOCK_MAGIC[4] = {'R', 'C', 'B', '1'};
+
+#pragma pack(push, 1)
+    struct BlockHeader
+    {
+        char magic[4];
+        uint8_t table;
+        uint8_t columns;
+        uint16_t reserved;
+        uint32_t rows;
+        uint32_t bytes; // ヘッダを除いたブロックのバイト数
+    };
+#pragma pack(pop)
+
+    // 各テーブルの列のバイト数
+    const int IMAGE_WIDTHS[NUM_IMAGE_COLUMNS] = {4, 4, 4, 4, 2, 2, 2, 4, 4};
+    const int BLOB_WIDTHS[NUM_BLOB_COLUMNS] = {4, 1, 2, 2, 2, 2, 4, 4, 4};
+
+    template <typename T>
+    void put(std::vector<unsigned char> &column, T value)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        column.insert(column.end(), bytes, bytes + sizeof(T));
+    }
+
+    uint16_t clamp16(int value)
+    {
+        return uint16_t(value < 0 ? 0 : (value > 0xFFFF ? 0xFFFF : value));
+    }
+}
+
+// ヘッダを先頭から辿り、完全なブロックごとに onBlock を呼ぶ
+// 正しいブロックが続いている部分のバイト数を返す
+// (途中で切れたブロックや、列数・バイト数がテーブルと合わないブロック以降は含めない)
+static long scanBlocks(FILE *fp, const std::string &filename, const std::function<void(const BlockHeader &, long)> &onBlock)
+{
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    long offset = 0;
+
+    while (offset + long(sizeof(BlockHeader)) <= size)
+    {
+        BlockHeader header;
+        fseek(fp, offset, SEEK_SET);
+        if (fread(&header, sizeof(header), 1, fp) != 1 || std::memcmp(header.magic, BLOCK_MAGIC, 4) != 0 ||
+            header.table >= NUM_RESULT_TABLES)
+        {
+            fprintf(stderr, "壊れたブロックがあるため以降を無視します: %s (%ld バイト目)\n", filename.c_str(), offset);
+            break;
+        }
+        long data = offset + long(sizeof(BlockHeader));
+        if (data + long(header.bytes) > size)
+            break; // 書き込み途中で止まったブロック
+
+        // 列数とバイト数がテーブルの定義と合っているか
+        ResultTable table = ResultTable(header.table);
+        int columns = ResultReader::columnCount(table);
+        uint64_t bytes = 0;
+        for (int c = 0; c < columns; c++)
+            bytes += uint64_t(ResultReader::columnWidth(table, c)) * header.rows;
+        bool valid = (header.columns == columns) &&
+                     (table == NAME_TABLE ? header.bytes >= bytes : header.bytes == bytes);
+        if (!valid)
+        {
+            fprintf(stderr, "列の大きさが合わないブロックがあるため以降を無視します: %s (%ld バイト目)\n", filename.c_str(), offset);
+            break;
+        }
+
+        onBlock(header, data);
+        offset = data + long(header.bytes);
+    }
+    return offset;
+}
+
+int ResultReader::columnWidth(ResultTable table, int column)
+{
+    if (table == IMAGE_TABLE)
+        return IMAGE_WIDTHS[column];
+    if (table == BLOB_TABLE)
+        return BLOB_WIDTHS[column];
+    return 4;
+}
+
+int ResultReader::columnCount(ResultTable table)
+{
+    if (table == IMAGE_TABLE)
+        return NUM_IMAGE_COLUMNS;
+    if (table == BLOB_TABLE)
+        return NUM_BLOB_COLUMNS;
+    return 2;
+}
+
+// ------------------------------------------------------------
+// 書き込み
+// ------------------------------------------------------------
+
+ResultWriter::ResultWriter(size_t rowsPerBlock) : fp(nullptr), rowsPerBlock(rowsPerBlock ? rowsPerBlock : 1)
+{
+    for (int table = 0; table < NUM_RESULT_TABLES; table++)
+        buffers[table].columns.resize(ResultReader::columnCount(ResultTable(table)));
+}
+
+ResultWriter::~ResultWriter()
+{
+    close();
+}
+
+bool ResultWriter::open(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fp = fopen(filename.c_str(), "a+b");
+    if (!fp)
+    {
+        fprintf(stderr, "ファイルを作成できませんでした: %s\n", filename.c_str());
+        return false;
+    }
+
+    // 前回の書き込みが途中で止まっていれば、最後の完全なブロックまで切り詰めてから追記する
+    // (そのまま追記すると、切れたブロックのヘッダが新しいブロックまで含むように読まれてしまう)
+    long valid = scanBlocks(fp, filename, [](const BlockHeader &, long) {});
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) != valid)
+    {
+        fprintf(stderr, "途中で切れたブロックを削除しました: %s (%ld バイト目以降)\n", filename.c_str(), valid);
+        fflush(fp);
+        if (ftruncate(fileno(fp), off_t(valid)) != 0)
+        {
+            fprintf(stderr, "ファイルを切り詰められませんでした: %s\n", filename.c_str());
+            fclose(fp);
+            fp = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ResultWriter::appendImage(const ImageRecord &record, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer &b = buffers[IMAGE_TABLE];
+    put<uint32_t>(b.columns[IMAGE_ID], record.image_id);
+    put<uint32_t>(b.columns[IMAGE_APPLE_PX], uint32_t(record.pixels.apple));
+    put<uint32_t>(b.columns[IMAGE_ORANGE_PX], uint32_t(record.pixels.orange));
+    put<uint32_t>(b.columns[IMAGE_STEM_PX], uint32_t(record.pixels.stem));
+    put<uint16_t>(b.columns[IMAGE_APPLES], clamp16(record.count.apples));
+    put<uint16_t>(b.columns[IMAGE_ORANGES], clamp16(record.count.oranges));
+    put<uint16_t>(b.columns[IMAGE_PERSIMMONS], clamp16(record.count.persimmons));
+    put<uint32_t>(b.columns[IMAGE_LOAD_US], record.load_us);
+    put<uint32_t>(b.columns[IMAGE_CLASSIFY_US], record.classify_us);
+    if (++b.rows >= rowsPerBlock)
+        flushTable(IMAGE_TABLE);
+
+    if (!name.empty())
+    {
+        Buffer &n = buffers[NAME_TABLE];
+        put<uint32_t>(n.columns[0], record.image_id);
+        nameChars.insert(nameChars.end(), name.begin(), name.end());
+        put<uint32_t>(n.columns[1], uint32_t(nameChars.size()));
+        if (++n.rows >= rowsPerBlock)
+            flushTable(NAME_TABLE);
+    }
+}
+
+void ResultWriter::appendBlob(const BlobRecord &record)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer &b = buffers[BLOB_TABLE];
+    put<uint32_t>(b.columns[BLOB_IMAGE_ID], record.image_id);
+    put<uint8_t>(b.columns[BLOB_COLOR], record.color);
+    put<uint16_t>(b.columns[BLOB_X0], record.x0);
+    put<uint16_t>(b.columns[BLOB_Y0], record.y0);
+    put<uint16_t>(b.columns[BLOB_X1], record.x1);
+    put<uint16_t>(b.columns[BLOB_Y1], record.y1);
+    put<float>(b.columns[BLOB_CX], record.cx);
+    put<float>(b.columns[BLOB_CY], record.cy);
+    put<uint32_t>(b.columns[BLOB_AREA], record.area);
+    if (++b.rows >= rowsPerBlock)
+        flushTable(BLOB_TABLE);
+}
+
+// 1テーブル分のバッファをブロックとして書き出す (mutex を取った状態で呼ぶ)
+void ResultWriter::flushTable(ResultTable table)
+{
+    Buffer &b = buffers[table];
+    if (b.rows == 0 || !fp)
+        return;
+
+    BlockHeader header;
+    std::memcpy(header.magic, BLOCK_MAGIC, 4);
+    header.table = uint8_t(table);
+    header.columns = uint8_t(b.columns.size());
+    header.reserved = 0;
+    header.rows = uint32_t(b.rows);
+    header.bytes = 0;
+    for (const auto &column : b.columns)
+        header.bytes += uint32_t(column.size());
+    if (table == NAME_TABLE)
+        header.bytes += uint32_t(nameChars.size());
+
+    // ブロック単位でまとめて書くので、途中で止まっても切れるのは最後のブロックだけ
+    fwrite(&header, sizeof(header), 1, fp);
+    for (auto &column : b.columns)
+    {
+        fwrite(column.data(), 1, column.size(), fp);
+        column.clear();
+    }
+    if (table == NAME_TABLE)
+    {
+        fwrite(nameChars.data(), 1, nameChars.size(), fp);
+        nameChars.clear();
+    }
+    b.rows = 0;
+}
+
+void ResultWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int table = 0; table < NUM_RESULT_TABLES; table++)
+        flushTable(ResultTable(table));
+    if (fp)
+        fflush(fp);
+}
+
+void ResultWriter::close()
+{
+    flush();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fp)
+    {
+        fclose(fp);
+        fp = nullptr;
+    }
+}
+
+// ------------------------------------------------------------
+// 読み込み
+// ------------------------------------------------------------
+
+ResultReader::~ResultReader()
+{
+    if (fp)
+        fclose(fp);
+}
+
+bool ResultReader::open(const std::string &filename)
+{
+    fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "ファイルを開けませんでした: %s\n", filename.c_str());
+        return false;
+    }
+
+    // ヘッダだけを辿ってブロックの位置を集める
+    blocks.clear();
+    scanBlocks(fp, filename, [&](const BlockHeader &header, long data)
+               { blocks.push_back({ResultTable(header.table), header.rows, data, header.bytes}); });
+    return true;
+}
+
+size_t ResultReader::rows(ResultTable table) const
+{
+    size_t total = 0;
+    for (const auto &block : blocks)
+        if (block.table == table)
+            total += block.rows;
+    return total;
+}
+
+bool ResultReader::readRaw(ResultTable table, int column, std::vector<unsigned char> &out, int &width)
+{
+    if (column < 0 || column >= columnCount(table))
+        return false;
+    width = columnWidth(table, column);
+
+    out.clear();
+    for (const auto &block : blocks)
+    {
+        if (block.table != table)
+            continue;
+
+        // 前の列のバイト数だけ読み飛ばす
+        long skip = 0;
+        for (int c = 0; c < column; c++)
+            skip += long(columnWidth(table, c)) * block.rows;
+
+        size_t start = out.size();
+        out.resize(start + size_t(width) * block.rows);
+        fseek(fp, block.offset + skip, SEEK_SET);
+        if (fread(out.data() + start, size_t(width), block.rows, fp) != block.rows)
+            return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> ResultReader::readUInt(ResultTable table, int column)
+{
+    std::vector<uint32_t> values;
+    std::vector<unsigned char> raw;
+    int width;
+    if (!readRaw(table, column, raw, width))
+        return values;
+
+    values.resize(raw.size() / width);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        uint32_t v = 0;
+        std::memcpy(&v, &raw[i * width], size_t(width)); // リトルエンディアン前提
+        values[i] = v;
+    }
+    return values;
+}
+
+std::vector<float> ResultReader::readFloat(ResultTable table, int column)
+{
+    std::vector<float> values;
+    std::vector<unsigned char> raw;
+    int width;
+    if (!readRaw(table, column, raw, width) || width != 4)
+        return values;
+
+    values.resize(raw.size() / 4);
+    std::memcpy(values.data(), raw.data(), raw.size());
+    return values;
+}
+
+std::vector<std::pair<uint32_t, std::string>> ResultReader::readNames()
+{
+    std::vector<std::pair<uint32_t, std::string>> names;
+    for (const auto &block : blocks)
+    {
+        if (block.table != NAME_TABLE)
+            continue;
+
+        if (block.bytes < 8 * block.rows)
+            break;
+        std::vector<unsigned char> data(block.bytes);
+        fseek(fp, block.offset, SEEK_SET);
+        if (fread(data.data(), 1, data.size(), fp) != data.size())
+            break;
+
+        const unsigned char *ids = data.data();
+        const unsigned char *ends = ids + 4 * block.rows;
+        const char *chars = reinterpret_cast<const char *>(ends + 4 * block.rows);
+        uint32_t charBytes = block.bytes - 8 * block.rows;
+        uint32_t begin = 0;
+        for (uint32_t i = 0; i < block.rows; i++)
+        {
+            uint32_t id, end;
+            std::memcpy(&id, ids + 4 * i, 4);
+            std::memcpy(&end, ends + 4 * i, 4);
+            if (end < begin || end > charBytes)
+                break;
+            names.push_back({id, std::string(chars + begin, chars + end)});
+            begin = end;
+        }
+    }
+    return names;
+}
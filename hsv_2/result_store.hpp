@@ -0,0 +1,117 @@
+#pragma once
+#include "hsv_filter.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 判定結果を保存する列指向のバイナリ形式
+// 結果はテーブル (画像 / 果物の塊 / ファイル名) ごとに列単位でまとめ、
+// 一定行数ごとにブロックとしてファイル末尾に追記する。
+// 集計では必要な列だけを読めばよいので、テキストを出力して解析するより軽い
+//
+// ブロックの形式
+//   BlockHeader (16 bytes), 列0の値 × 行数, 列1の値 × 行数, ...
+//   ファイル名テーブルのみ: 画像ID (uint32) × 行数, 終端位置 (uint32) × 行数, 文字列
+
+// 1画像分の結果
+struct ImageRecord {
+    uint32_t image_id;
+    PixelCounts pixels;
+    FruitCount count;
+    uint32_t load_us;     // 読み込みにかかった時間 (マイクロ秒)
+    uint32_t classify_us; // 判定にかかった時間 (マイクロ秒)
+};
+
+// 果物の塊 (連結成分) 1つ分の結果
+struct BlobRecord {
+    uint32_t image_id;
+    uint8_t color;         // FruitColor
+    uint16_t x0, y0, x1, y1; // 外接矩形
+    float cx, cy;          // 重心
+    uint32_t area;         // ピクセル数
+};
+
+enum ResultTable {
+    IMAGE_TABLE = 0,
+    BLOB_TABLE = 1,
+    NAME_TABLE = 2,
+    NUM_RESULT_TABLES = 3
+};
+
+// 列の番号
+enum ImageColumn {
+    IMAGE_ID, IMAGE_APPLE_PX, IMAGE_ORANGE_PX, IMAGE_STEM_PX,
+    IMAGE_APPLES, IMAGE_ORANGES, IMAGE_PERSIMMONS, IMAGE_LOAD_US, IMAGE_CLASSIFY_US,
+    NUM_IMAGE_COLUMNS
+};
+enum BlobColumn {
+    BLOB_IMAGE_ID, BLOB_COLOR, BLOB_X0, BLOB_Y0, BLOB_X1, BLOB_Y1,
+    BLOB_CX, BLOB_CY, BLOB_AREA,
+    NUM_BLOB_COLUMNS
+};
+
+// 追記専用の書き込みクラス (複数スレッドから呼び出してよい)
+class ResultWriter {
+public:
+    explicit ResultWriter(size_t rowsPerBlock = 4096);
+    ~ResultWriter();
+
+    // 既存のファイルがあれば末尾に追記する
+    // (書き込み途中で切れたブロックがあれば、最後の完全なブロックまで切り詰める)
+    bool open(const std::string& filename);
+    void appendImage(const ImageRecord& record, const std::string& name = "");
+    void appendBlob(const BlobRecord& record);
+    // バッファにある行をブロックとして書き出す
+    void flush();
+    void close();
+
+private:
+    struct Buffer {
+        std::vector<std::vector<unsigned char>> columns;
+        size_t rows = 0;
+    };
+
+    std::mutex mutex;
+    FILE* fp;
+    size_t rowsPerBlock;
+    Buffer buffers[NUM_RESULT_TABLES];
+    std::vector<unsigned char> nameChars;
+
+    void flushTable(ResultTable table);
+};
+
+// 読み込みクラス
+class ResultReader {
+public:
+    ~ResultReader();
+
+    // ブロックの一覧だけを読む
+    // (途中で切れた最後のブロック、列数・バイト数が合わないブロック以降は無視する)
+    bool open(const std::string& filename);
+    size_t rows(ResultTable table) const;
+
+    // 1列分の値を全ブロックから読み出す (他の列は読み飛ばす)
+    std::vector<uint32_t> readUInt(ResultTable table, int column);
+    std::vector<float> readFloat(ResultTable table, int column);
+    // 画像IDとファイル名の対応
+    std::vector<std::pair<uint32_t, std::string>> readNames();
+
+    // 列のバイト数
+    static int columnWidth(ResultTable table, int column);
+    static int columnCount(ResultTable table);
+
+private:
+    struct Block {
+        ResultTable table;
+        uint32_t rows;
+        long offset;   // 列データの先頭位置
+        uint32_t bytes;
+    };
+
+    FILE* fp = nullptr;
+    std::vector<Block> blocks;
+
+    bool readRaw(ResultTable table, int column, std::vector<unsigned char>& out, int& width);
+};
@@ -0,0 +1,95 @@
+#include "sequence_counter.hpp"
+#include <algorithm>
+#include <cstring>
+
+SequenceCounter::SequenceCounter(HSVFilter &filter, int tileSize)
+    : filter(filter), tileSize(tileSize), width(0), height(0), tilesX(0), changedTiles(0)
+{
+}
+
+void SequenceCounter::reset()
+{
+    tiles.clear();
+    width = 0;
+    height = 0;
+}
+
+// タイル内の生データから64ビットのハッシュを作る
+// 8バイトずつ読み、乗算とシフトで混ぜるだけの軽い処理
+uint64_t SequenceCounter::hashTile(const unsigned char *bgr, size_t stride, size_t x0, size_t y0, size_t w, size_t h) const
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    size_t bytes = w * 3;
+
+    for (size_t y = y0; y < y0 + h; y++)
+    {
+        const unsigned char *p = bgr + stride * y + x0 * 3;
+        size_t i = 0;
+        for (; i + 8 <= bytes; i += 8)
+        {
+            uint64_t v;
+            std::memcpy(&v, p + i, 8);
+            hash = (hash ^ v) * prime;
+            hash ^= hash >> 29;
+        }
+        uint64_t rest = 0;
+        std::memcpy(&rest, p + i, bytes - i);
+        hash = (hash ^ rest ^ (uint64_t(y) << 32)) * prime;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+FruitCount SequenceCounter::processFrame(const unsigned char *bgr, int frameWidth, int frameHeight, size_t stride)
+{
+    size_t w = size_t(frameWidth);
+    size_t h = size_t(frameHeight);
+
+    // 画像サイズが変わったらタイルを作り直す
+    if (w != width || h != height)
+    {
+        width = w;
+        height = h;
+        tilesX = int((w + tileSize - 1) / tileSize);
+        int tilesY = int((h + tileSize - 1) / tileSize);
+        tiles.assign(size_t(tilesX) * tilesY, Tile());
+        for (auto &tile : tiles)
+        {
+            // 最初のフレームでは必ず判定させるため、ありえない値にしておく
+            tile.hash = 0;
+            tile.counts = {-1, -1, -1};
+        }
+    }
+
+    PixelCounts total = {0, 0, 0};
+    changedTiles = 0;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        size_t x0 = (i % tilesX) * tileSize;
+        size_t y0 = (i / tilesX) * tileSize;
+        size_t tw = std::min<size_t>(tileSize, width - x0);
+        size_t th = std::min<size_t>(tileSize, height - y0);
+        Tile &tile = tiles[i];
+
+        uint64_t hash = hashTile(bgr, stride, x0, y0, tw, th);
+        if (hash != tile.hash || tile.counts.apple < 0)
+        {
+            // 変化したタイルだけ判定し直す
+            tile.hash = hash;
+            tile.counts = {0, 0, 0};
+            for (size_t y = y0; y < y0 + th; y++)
+            {
+                filter.countBgrRow(bgr + stride * y + x0 * 3, tw, tile.counts);
+            }
+            changedTiles++;
+        }
+
+        total.apple += tile.counts.apple;
+        total.orange += tile.counts.orange;
+        total.stem += tile.counts.stem;
+    }
+
+    return filter.estimateCount(total);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "hsv_filter.hpp"
+#include <cstdint>
+#include <vector>
+
+// 連番フレームを処理するクラス
+// 前フレームから変化していないタイルは判定をやり直さず、
+// タイルごとのピクセル数をそのまま引き継ぐ
+class SequenceCounter
+{
+public:
+    explicit SequenceCounter(HSVFilter &filter, int tileSize = 64);
+
+    // 1フレーム分 (BGRの生データ, stride: 1行のバイト数) を処理して果物の数を返す
+    // 画像を展開せずに読むので、BMPファイルの画素部分をそのまま渡せる
+    // (数えるだけなので行の上下の向きは問わない)
+    FruitCount processFrame(const unsigned char *bgr, int width, int height, size_t stride);
+
+    // 直前のフレームで判定し直したタイル数 / 全タイル数
+    int getChangedTiles() const { return changedTiles; }
+    int getTotalTiles() const { return int(tiles.size()); }
+
+    // 次のフレームを全タイル判定し直す
+    void reset();
+
+private:
+    struct Tile
+    {
+        uint64_t hash;
+        PixelCounts counts;
+    };
+
+    HSVFilter &filter;
+    int tileSize;
+    size_t width;
+    size_t height;
+    int tilesX;
+    std::vector<Tile> tiles;
+    int changedTiles;
+
+    uint64_t hashTile(const unsigned char *bgr, size_t stride, size_t x0, size_t y0, size_t w, size_t h) const;
+};
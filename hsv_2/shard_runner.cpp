@@ -0,0 +1,382 @@
+// 画像一覧 (マニフェスト) をN個のシャードに分け、子プロセスで並列に処理する
+// 処理済みの画像はシャードごとの結果ファイルにブロック単位 (4096件ごと) で追記され、
+// 中断しても再実行すれば続きから処理する
+// シャード数は出力ディレクトリの shards.txt に記録し、再開時も同じ分け方で処理する
+//
+// 使い方: ./shard_runner manifest.txt 出力ディレクトリ [シャード数]
+//         ./shard_runner --merge manifest.txt 出力ディレクトリ [シャード数]
+// 各画像のピクセル数や処理時間は shard_N.col (result_store.hpp の形式) にも追記される
+#include "hsv_filter.hpp"
+#include "manifest.hpp"
+#include "result_store.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// 列指向の結果ファイルの1ブロックの行数 (チェックポイントの間隔も兼ねる)
+const size_t BLOCK_ROWS = 4096;
+
+struct ShardResult
+{
+    std::string filename;
+    FruitCount count;
+};
+
+// ファイル名からシャード番号を決める (FNV-1a, 実行ごとに同じ結果になる)
+int shardOf(const std::string &filename, int shards)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : filename)
+    {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return int(hash % uint32_t(shards));
+}
+
+std::string shardPath(const std::string &outDir, int shard)
+{
+    return outDir + "/shard_" + std::to_string(shard) + ".tsv";
+}
+
+// 結果ファイルを読み込む
+// 途中で書き込みが止まった行 (改行なし・列不足) は捨てる
+// complete には最後の改行までのバイト数が入る
+std::vector<ShardResult> readShardResults(const std::string &path, size_t *complete = nullptr)
+{
+    std::vector<ShardResult> results;
+    if (complete)
+        *complete = 0;
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return results;
+
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (complete)
+        *complete = content.rfind('\n') + 1; // 改行がなければ npos + 1 = 0
+    size_t begin = 0;
+    size_t end;
+    while ((end = content.find('\n', begin)) != std::string::npos)
+    {
+        std::string line = content.substr(begin, end - begin);
+        begin = end + 1;
+
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos)
+            continue;
+        ShardResult result;
+        result.filename = line.substr(0, tab);
+        std::istringstream in(line.substr(tab + 1));
+        if (in >> result.count.apples >> result.count.oranges >> result.count.persimmons)
+            results.push_back(result);
+    }
+    return results;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 1つのシャードを処理する (子プロセスで実行)
+int runShard(const std::vector<TestCase> &entries, const std::string &outDir, int shard, int shards)
+{
+    std::string path = shardPath(outDir, shard);
+
+    // チェックポイント: 書き込み途中で止まった最後の行だけを切り詰め、続きに追記する
+    // (ファイルを書き直さないので、ここで中断されても処理済みの結果は失われない)
+    size_t complete = 0;
+    std::vector<ShardResult> done = readShardResults(path, &complete);
+    std::set<std::string> finished;
+    for (const auto &result : done)
+        finished.insert(result.filename);
+
+    FILE *fp = fopen(path.c_str(), "ab");
+    if (!fp || ftruncate(fileno(fp), off_t(complete)) != 0)
+    {
+        std::cerr << "結果ファイルを作成できませんでした: " << path << "\n";
+        if (fp)
+            fclose(fp);
+        return 1;
+    }
+
+    HSVFilter filter;
+    filter.setVerbose(false);
+
+    // 列指向の結果ファイル (画像IDはマニフェスト内の画像の通し番号, 0から)
+    // 途中で切れたブロックは open で切り詰められる
+    // 既に記録済みの画像はファイル名で見分け、二重に追記しない
+    // (マニフェストを編集すると通し番号はずれるので、画像IDでは比べない)
+    std::string storePath = outDir + "/shard_" + std::to_string(shard) + ".col";
+    ResultWriter store(BLOCK_ROWS);
+    if (!store.open(storePath))
+    {
+        fclose(fp);
+        return 1;
+    }
+    std::set<std::string> stored;
+    {
+        ResultReader reader;
+        if (reader.open(storePath))
+        {
+            for (const auto &name : reader.readNames())
+                stored.insert(name.second);
+        }
+    }
+
+    // tsv の行は、同じ画像の行を含むブロックを列指向のファイルに書き出してからまとめて追記する
+    // 再開時は tsv を元に処理済みかを決めるので、tsv にある画像は必ず列指向のファイルにもある
+    // (中断すると最後のブロック分は処理し直しになる)
+    std::vector<std::string> pending;
+    auto checkpoint = [&]()
+    {
+        store.flush();
+        for (const auto &line : pending)
+            fputs(line.c_str(), fp);
+        fflush(fp);
+        pending.clear();
+    };
+
+    int processed = 0;
+    for (size_t index = 0; index < entries.size(); index++)
+    {
+        const TestCase &entry = entries[index];
+        if (shardOf(entry.filename, shards) != shard || finished.count(entry.filename))
+            continue;
+
+        auto elapsedUs = [](std::chrono::steady_clock::time_point from)
+        {
+            return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - from).count());
+        };
+
+        ImageRecord record = {};
+        record.image_id = uint32_t(index);
+        auto start = std::chrono::steady_clock::now();
+        if (endsWith(entry.filename, ".png"))
+        {
+            // PNGは読み込みながら判定するので、全体を判定時間とする
+            if (!filter.countPixelsPng(entry.filename, record.pixels))
+                continue;
+            record.classify_us = elapsedUs(start);
+        }
+        else
+        {
+            auto image = filter.loadBmpImage(entry.filename);
+            if (image.empty())
+                continue;
+            record.load_us = elapsedUs(start);
+            start = std::chrono::steady_clock::now();
+            record.pixels = filter.countPixels(image);
+            record.classify_us = elapsedUs(start);
+        }
+        FruitCount count = filter.estimateCount(record.pixels);
+        record.count = count;
+        if (!stored.count(entry.filename))
+            store.appendImage(record, entry.filename);
+
+        char counts[64];
+        snprintf(counts, sizeof(counts), "\t%d\t%d\t%d\n", count.apples, count.oranges, count.persimmons);
+        pending.push_back(entry.filename + counts);
+        if (pending.size() >= BLOCK_ROWS)
+            checkpoint();
+        processed++;
+    }
+
+    checkpoint();
+    fclose(fp);
+    store.close();
+    std::cerr << "シャード " << shard << ": " << processed << "件処理 (再開時スキップ " << finished.size() << "件)\n";
+    return 0;
+}
+
+// 全シャードの結果をまとめ、正解との誤差を集計する
+int mergeResults(const std::vector<TestCase> &entries, const std::string &outDir, int shards)
+{
+    std::map<std::string, FruitCount> detected;
+    for (int shard = 0; shard < shards; shard++)
+    {
+        for (const auto &result : readShardResults(shardPath(outDir, shard)))
+            detected[result.filename] = result.count;
+    }
+
+    std::string reportPath = outDir + "/report.txt";
+    std::ofstream report(reportPath);
+    if (!report)
+    {
+        std::cerr << "レポートを作成できませんでした: " << reportPath << "\n";
+        return 1;
+    }
+
+    int total = 0, missing = 0, evaluated = 0, exact = 0;
+    int errorApples = 0, errorOranges = 0, errorPersimmons = 0;
+
+    // マニフェストの順に出力するので、シャード数によらず同じレポートになる
+    for (const auto &entry : entries)
+    {
+        total++;
+        auto it = detected.find(entry.filename);
+        if (it == detected.end())
+        {
+            missing++;
+            report << entry.filename << "\t未処理\n";
+            continue;
+        }
+        const FruitCount &count = it->second;
+        report << entry.filename
+               << "\t検出 りんご:" << count.apples
+               << " みかん:" << count.oranges
+               << " かき:" << count.persimmons;
+
+        if (entry.actual_apples >= 0)
+        {
+            int da = count.apples - entry.actual_apples;
+            int dob = count.oranges - entry.actual_oranges;
+            int dp = count.persimmons - entry.actual_persimmons;
+            report << "\t誤差 りんご:" << da << " みかん:" << dob << " かき:" << dp;
+            evaluated++;
+            if (da == 0 && dob == 0 && dp == 0)
+                exact++;
+            errorApples += std::abs(da);
+            errorOranges += std::abs(dob);
+            errorPersimmons += std::abs(dp);
+        }
+        report << "\n";
+    }
+
+    std::ostringstream summary;
+    summary << "\n画像数: " << total << " (未処理 " << missing << ")\n";
+    if (evaluated > 0)
+    {
+        summary << "正解と完全一致: " << exact << "/" << evaluated
+                << " (" << (100.0 * exact / evaluated) << "%)\n";
+        summary << "誤差の絶対値の合計 - りんご:" << errorApples
+                << " みかん:" << errorOranges
+                << " かき:" << errorPersimmons << "\n";
+    }
+    report << summary.str();
+    std::cout << summary.str() << "レポート: " << reportPath << "\n";
+
+    return missing > 0 ? 1 : 0;
+}
+
+// 出力ディレクトリに記録したシャード数を使う
+// 記録がなければ requested を記録する。指定した数と記録が違う場合は -1 を返す
+int resolveShards(const std::string &outDir, int requested, bool specified, bool record)
+{
+    std::string path = outDir + "/shards.txt";
+    int stored = 0;
+    std::ifstream in(path);
+    if (in >> stored && stored >= 1)
+    {
+        if (specified && stored != requested)
+        {
+            std::cerr << "出力ディレクトリは " << stored << " シャードで処理されています (指定: "
+                      << requested << ")。同じシャード数で再実行してください: " << path << "\n";
+            return -1;
+        }
+        return stored;
+    }
+
+    if (record)
+    {
+        // 書き込み途中で止まっても壊れた記録が残らないよう、一時ファイルから置き換える
+        std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "wb");
+        if (!fp || fprintf(fp, "%d\n", requested) < 0 || fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "シャード数を記録できませんでした: " << path << "\n";
+            return -1;
+        }
+    }
+    return requested;
+}
+
+int main(int argc, char *argv[])
+{
+    bool mergeOnly = (argc >= 2 && std::string(argv[1]) == "--merge");
+    int first = mergeOnly ? 2 : 1;
+    if (argc < first + 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--merge] manifest.txt output_dir [shards]\n";
+        return 1;
+    }
+
+    std::string manifestPath = argv[first];
+    std::string outDir = argv[first + 1];
+    bool specified = (argc > first + 2);
+    int shards;
+    if (specified)
+    {
+        // 数字以外や範囲外の値は受け付けない
+        char *end;
+        errno = 0;
+        long value = std::strtol(argv[first + 2], &end, 10);
+        if (end == argv[first + 2] || *end != '\0' || errno == ERANGE || value < 1 || value > INT_MAX)
+        {
+            std::cerr << "Usage: " << argv[0] << " [--merge] manifest.txt output_dir [shards (1以上)]\n";
+            return 1;
+        }
+        shards = int(value);
+    }
+    else
+    {
+        shards = std::max(1, int(sysconf(_SC_NPROCESSORS_ONLN)));
+    }
+
+    auto entries = loadManifest(manifestPath);
+    if (entries.empty())
+        return 1;
+
+    if (!mergeOnly)
+        mkdir(outDir.c_str(), 0755);
+    shards = resolveShards(outDir, shards, specified, !mergeOnly);
+    if (shards < 1)
+        return 1;
+
+    if (!mergeOnly)
+    {
+
+        // シャードごとに子プロセスを起動
+        std::vector<pid_t> workers;
+        for (int shard = 0; shard < shards; shard++)
+        {
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                return 1;
+            }
+            if (pid == 0)
+                _exit(runShard(entries, outDir, shard, shards));
+            workers.push_back(pid);
+        }
+
+        bool failed = false;
+        for (pid_t pid : workers)
+        {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                failed = true;
+        }
+        if (failed)
+            std::cerr << "失敗したシャードがあります。再実行すると続きから処理します。\n";
+    }
+
+    return mergeResults(entries, outDir, shards);
+}
@@ -0,0 +1,108 @@
+// 共有メモリへのフレーム書き込みのサンプル (カメラ側の代わり)
+// BMPを読み込んでBGRの生データとしてリングバッファに書き込む
+//
+// 使い方: ./shm_producer 共有メモリ名 [--slots N] [--repeat N] [--interval-ms N] [--wait-ms N] 画像.bmp...
+// 判定側: ./main --shm 共有メモリ名
+// 判定側が開くまで --wait-ms (既定 10000, 0 で待たない) だけ待ってから書き込みを始める
+#include "hsv_filter.hpp"
+#include "shm_ring.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " shm_name [--slots N] [--repeat N] [--interval-ms N] [--wait-ms N] image.bmp...\n";
+        return 1;
+    }
+
+    std::string name = argv[1];
+    int slots = 4;
+    int repeat = 1;
+    int intervalMs = 0;
+    int waitMs = 10000;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--slots" && i + 1 < argc)
+            slots = std::stoi(argv[++i]);
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::stoi(argv[++i]);
+        else if (arg == "--interval-ms" && i + 1 < argc)
+            intervalMs = std::stoi(argv[++i]);
+        else if (arg == "--wait-ms" && i + 1 < argc)
+            waitMs = std::stoi(argv[++i]);
+        else
+            files.push_back(arg);
+    }
+
+    // BGRの生データに変換しておく (カメラから届くフレームの代わり)
+    HSVFilter filter;
+    int width = 0, height = 0;
+    std::vector<std::vector<unsigned char>> frames;
+    for (const auto &file : files)
+    {
+        auto image = filter.loadBmpImage(file);
+        if (image.empty())
+            continue;
+        if (frames.empty())
+        {
+            height = int(image.size());
+            width = int(image[0].size());
+        }
+        if (int(image.size()) != height || int(image[0].size()) != width)
+        {
+            std::cerr << "サイズが異なるため省略: " << file << "\n";
+            continue;
+        }
+        std::vector<unsigned char> bgr(size_t(width) * height * 3);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                unsigned char *p = &bgr[(size_t(y) * width + x) * 3];
+                p[0] = image[y][x].b;
+                p[1] = image[y][x].g;
+                p[2] = image[y][x].r;
+            }
+        }
+        frames.push_back(std::move(bgr));
+    }
+    if (frames.empty())
+        return 1;
+
+    ShmFrameRing ring;
+    if (!ring.create(name, width, height, slots))
+        return 1;
+    std::cerr << "共有メモリ " << name << " を作成しました (" << width << "x" << height << ", " << slots << "スロット)\n";
+
+    // 判定側がいないうちに書き込むと、空きがなくなってほとんどのフレームを捨ててしまう
+    if (waitMs > 0 && !ring.waitForReader(waitMs))
+        std::cerr << "判定側が開かないまま書き込みを始めます\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (const auto &bgr : frames)
+        {
+            uint64_t timestamp = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - start)
+                                              .count());
+            ring.pushFrame(bgr.data(), size_t(width) * 3, timestamp);
+            if (intervalMs > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+    }
+
+    ring.close();
+    std::cerr << ring.written() << "フレーム書き込み (捨てたフレーム " << ring.dropped() << ")\n";
+    // 読み込み側が開いた後なら、名前を消しても読み込み側は最後まで読める
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    ShmFrameRing::unlink(name);
+    return 0;
+}
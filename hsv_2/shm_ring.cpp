@@ -0,0 +1,301 @@
+#include "shm_ring.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    const uint32_t RING_MAGIC = 0x47524D46; // "FMRG"
+    const uint32_t RING_VERSION = 2;
+
+    template <typename T>
+    T loadAcquire(const T *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+    template <typename T>
+    void storeRelease(T *p, T value) { __atomic_store_n(p, value, __ATOMIC_RELEASE); }
+}
+
+// 共有メモリの先頭に置く管理情報
+// 書き込み側と読み込み側が別々に更新する値は、キャッシュラインを分けておく
+struct ShmFrameRing::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint64_t stride;
+    uint64_t slotCount;
+    uint64_t slotSize;   // スロット1つのバイト数 (SlotHeader を含む)
+    uint64_t dataOffset; // 先頭から最初のスロットまでのバイト数
+
+    alignas(64) uint64_t head; // 書き込み済みスロット数 (書き込み側のみ更新)
+    uint64_t frames;           // 受け取ったフレーム数 (書き込み側のみ更新)
+    uint64_t dropped;          // 捨てたフレーム数 (書き込み側のみ更新)
+    uint32_t closed;           // 書き込み側が終了したら1
+
+    alignas(64) uint64_t tail; // 読み終えたスロット数 (読み込み側のみ更新)
+    uint32_t attached;         // 読み込み側が開いたら1 (読み込み側のみ更新)
+};
+
+// 各スロットの先頭に置くフレーム情報
+struct ShmFrameRing::SlotHeader
+{
+    alignas(64) uint64_t sequence;
+    uint64_t timestamp;
+};
+
+ShmFrameRing::ShmFrameRing() : header(nullptr), base(nullptr), mappedSize(0), pendingSequence(0) {}
+
+ShmFrameRing::~ShmFrameRing()
+{
+    unmap();
+}
+
+void ShmFrameRing::unmap()
+{
+    if (base)
+        munmap(base, mappedSize);
+    base = nullptr;
+    header = nullptr;
+    mappedSize = 0;
+}
+
+bool ShmFrameRing::map(int fd, size_t size)
+{
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    base = static_cast<unsigned char *>(p);
+    header = reinterpret_cast<Header *>(base);
+    mappedSize = size;
+    return true;
+}
+
+bool ShmFrameRing::create(const std::string &name, int width, int height, int slots)
+{
+    if (width <= 0 || height <= 0 || slots <= 0)
+        return false;
+
+    size_t stride = size_t(width) * 3;
+    size_t slotSize = (sizeof(SlotHeader) + stride * height + 63) / 64 * 64;
+    size_t dataOffset = (sizeof(Header) + 4095) / 4096 * 4096;
+    size_t size = dataOffset + slotSize * slots;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0 || ftruncate(fd, off_t(size)) != 0)
+    {
+        printf("共有メモリを作成できませんでした: %s\n", name.c_str());
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    if (!map(fd, size))
+        return false;
+
+    std::memset(header, 0, sizeof(Header));
+    header->version = RING_VERSION;
+    header->width = width;
+    header->height = height;
+    header->stride = stride;
+    header->slotCount = uint64_t(slots);
+    header->slotSize = slotSize;
+    header->dataOffset = dataOffset;
+    // 初期化が終わってから magic を書き、読み込み側に見えるようにする
+    storeRelease(&header->magic, RING_MAGIC);
+    return true;
+}
+
+bool ShmFrameRing::open(const std::string &name, int timeoutMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        int result = tryOpen(name);
+        if (result > 0)
+            return true;
+        if (result < 0)
+            return false;
+        if (std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs))
+        {
+            printf("共有メモリを開けませんでした: %s\n", name.c_str());
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// 1回だけ開いてみる
+// 1: 開けた / 0: まだ作成・初期化されていない / -1: 開けない・形式が違う
+int ShmFrameRing::tryOpen(const std::string &name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0 && errno == ENOENT)
+        return 0;
+    if (fd < 0)
+    {
+        printf("共有メモリを開けませんでした: %s\n", name.c_str());
+        return -1;
+    }
+
+    // 作成直後は大きさが 0 のことがある
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return 0;
+    }
+    if (!map(fd, size_t(st.st_size)))
+    {
+        printf("共有メモリを開けませんでした: %s\n", name.c_str());
+        return -1;
+    }
+
+    // magic は初期化が終わってから書かれる
+    if (loadAcquire(&header->magic) != RING_MAGIC)
+    {
+        unmap();
+        return 0;
+    }
+    if (header->version != RING_VERSION || !validLayout())
+    {
+        printf("共有メモリの形式が正しくありません: %s\n", name.c_str());
+        unmap();
+        return -1;
+    }
+
+    storeRelease(&header->attached, 1u);
+    return 1;
+}
+
+// ヘッダに書かれた大きさが共有メモリの範囲に収まっているか確認する
+// (掛け算があふれないよう、割り算で比べる)
+bool ShmFrameRing::validLayout() const
+{
+    const Header &h = *header;
+    if (h.width <= 0 || h.height <= 0 || h.slotCount == 0)
+        return false;
+    if (h.stride < uint64_t(h.width) * 3)
+        return false;
+    if (h.slotSize < sizeof(SlotHeader) || h.slotSize % alignof(SlotHeader) != 0)
+        return false;
+    if ((h.slotSize - sizeof(SlotHeader)) / h.stride < uint64_t(h.height))
+        return false;
+    if (h.dataOffset < sizeof(Header) || h.dataOffset % alignof(SlotHeader) != 0 || h.dataOffset > mappedSize)
+        return false;
+    return (mappedSize - h.dataOffset) / h.slotSize >= h.slotCount;
+}
+
+void ShmFrameRing::unlink(const std::string &name)
+{
+    shm_unlink(name.c_str());
+}
+
+ShmFrameRing::SlotHeader *ShmFrameRing::slot(uint64_t index) const
+{
+    return reinterpret_cast<SlotHeader *>(base + header->dataOffset + header->slotSize * (index % header->slotCount));
+}
+
+unsigned char *ShmFrameRing::beginWrite()
+{
+    pendingSequence = header->frames;
+    storeRelease(&header->frames, pendingSequence + 1);
+
+    uint64_t head = header->head;
+    if (head - loadAcquire(&header->tail) >= header->slotCount)
+    {
+        // 読み込み側が追いついていないので、このフレームは捨てる
+        storeRelease(&header->dropped, header->dropped + 1);
+        return nullptr;
+    }
+    return reinterpret_cast<unsigned char *>(slot(head)) + sizeof(SlotHeader);
+}
+
+void ShmFrameRing::commitWrite(uint64_t timestamp)
+{
+    uint64_t head = header->head;
+    SlotHeader *s = slot(head);
+    s->sequence = pendingSequence;
+    s->timestamp = timestamp;
+    // データを書き終えてから head を進める
+    storeRelease(&header->head, head + 1);
+}
+
+bool ShmFrameRing::pushFrame(const unsigned char *bgr, size_t stride, uint64_t timestamp)
+{
+    unsigned char *dst = beginWrite();
+    if (!dst)
+        return false;
+
+    size_t rowBytes = size_t(header->width) * 3;
+    if (stride == header->stride)
+    {
+        std::memcpy(dst, bgr, rowBytes * header->height);
+    }
+    else
+    {
+        for (int y = 0; y < header->height; y++)
+            std::memcpy(dst + header->stride * y, bgr + stride * y, rowBytes);
+    }
+    commitWrite(timestamp);
+    return true;
+}
+
+void ShmFrameRing::close()
+{
+    storeRelease(&header->closed, 1u);
+}
+
+bool ShmFrameRing::waitForReader(int timeoutMs) const
+{
+    auto start = std::chrono::steady_clock::now();
+    while (!loadAcquire(&header->attached))
+    {
+        if (timeoutMs >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs))
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool ShmFrameRing::acquire(Frame &frame, int timeoutMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tail = header->tail;
+
+    // 新しいフレームが書き込まれるまで短い間隔で確認する
+    while (loadAcquire(&header->head) == tail)
+    {
+        if (loadAcquire(&header->closed) && loadAcquire(&header->head) == tail)
+            return false;
+        if (timeoutMs >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeoutMs))
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    SlotHeader *s = slot(tail);
+    frame.bgr = reinterpret_cast<const unsigned char *>(s) + sizeof(SlotHeader);
+    frame.width = header->width;
+    frame.height = header->height;
+    frame.stride = header->stride;
+    frame.sequence = s->sequence;
+    frame.timestamp = s->timestamp;
+    return true;
+}
+
+void ShmFrameRing::release()
+{
+    storeRelease(&header->tail, header->tail + 1);
+}
+
+int ShmFrameRing::width() const { return header->width; }
+int ShmFrameRing::height() const { return header->height; }
+size_t ShmFrameRing::stride() const { return header->stride; }
+uint64_t ShmFrameRing::written() const { return loadAcquire(&header->frames); }
+uint64_t ShmFrameRing::dropped() const { return loadAcquire(&header->dropped); }
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 共有メモリ上のフレームのリングバッファ (書き込み側1つ, 読み込み側1つ)
+// カメラ側 (書き込み) がBGRの生データをスロットに書き込み、
+// 判定側 (読み込み) はファイルを介さずにスロットの中身をそのまま判定する。
+// 空きスロットがないとき書き込み側は待たずにフレームを捨て、捨てた数を数える
+class ShmFrameRing
+{
+public:
+    // 読み込み側に渡すフレームの情報
+    struct Frame
+    {
+        const unsigned char *bgr; // スロット内のBGRデータ (release まで有効)
+        int width;
+        int height;
+        size_t stride;            // 1行のバイト数
+        uint64_t sequence;        // 書き込み側が付けた通し番号 (捨てたフレームも含む)
+        uint64_t timestamp;       // 書き込み側が指定した時刻など
+    };
+
+    ShmFrameRing();
+    ~ShmFrameRing();
+
+    // 書き込み側: 共有メモリを作成する
+    bool create(const std::string &name, int width, int height, int slots);
+    // 読み込み側: 作成済みの共有メモリを開く
+    // 書き込み側がまだ作成・初期化していなければ、timeoutMs ミリ秒まで待つ
+    bool open(const std::string &name, int timeoutMs = 0);
+    // 共有メモリの名前を削除する (作成側が終了時に呼ぶ)
+    static void unlink(const std::string &name);
+
+    // 書き込み側: 空きスロットを取得して直接書き込む (空きがなければ nullptr, そのフレームは捨てたものとして数える)
+    unsigned char *beginWrite();
+    void commitWrite(uint64_t timestamp = 0);
+    // 書き込み側: 1フレームをコピーして書き込む (stride はコピー元の1行のバイト数)
+    bool pushFrame(const unsigned char *bgr, size_t stride, uint64_t timestamp = 0);
+    // 書き込み側: これ以上フレームがないことを知らせる
+    void close();
+    // 書き込み側: 読み込み側が開くまで待つ (timeoutMs < 0 で無期限, タイムアウトで false)
+    bool waitForReader(int timeoutMs) const;
+
+    // 読み込み側: 次のフレームを待つ (timeoutMs < 0 で無期限, 終了またはタイムアウトで false)
+    bool acquire(Frame &frame, int timeoutMs = -1);
+    // 読み込み側: 判定が終わったスロットを返す
+    void release();
+
+    int width() const;
+    int height() const;
+    size_t stride() const;
+    uint64_t written() const;  // 書き込み側が受け取ったフレーム数 (捨てたものを含む)
+    uint64_t dropped() const;  // 空きがなく捨てたフレーム数
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    Header *header;
+    unsigned char *base;
+    size_t mappedSize;
+    uint64_t pendingSequence;
+
+    SlotHeader *slot(uint64_t index) const;
+    bool map(int fd, size_t size);
+    void unmap();
+    int tryOpen(const std::string &name);
+    bool validLayout() const;
+};
@@ -90,6 +90,17 @@ void BMPProcessor::setPixel(int x, int y, const Pixel &pixel)
     pixels[y * info_header.width + x] = pixel;
 }
 
+// 行の先頭ピクセルの取得
+Pixel *BMPProcessor::getRow(int y)
+{
+    // 座標の範囲チェック
+    if (y < 0 || y >= info_header.height)
+    {
+        throw std::out_of_range("Row out of range");
+    }
+    return &pixels[y * info_header.width];
+}
+
 // RGB値をHSV値に変換する
 HSVColor BMPProcessor::rgbToHSV(const Pixel &pixel) const
 {
@@ -74,6 +74,7 @@ public:
     // ピクセル操作
     Pixel &getPixel(int x, int y);                   // 指定座標のRGBピクセルを取得
     void setPixel(int x, int y, const Pixel &pixel); // 指定座標にRGBピクセルを設定
+    Pixel *getRow(int y);                            // 指定行の先頭ピクセル (行単位の高速な書き込み用)
 
     // HSV関連の操作
     HSVColor getHSVPixel(int x, int y) const; // 指定座標のHSV値を取得
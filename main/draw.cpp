@@ -0,0 +1,213 @@
+#include "draw.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+// 1行の [x0, x1] を塗りつぶす
+void fillSpan(BMPProcessor &image, int y, int x0, int x1, const Pixel &color)
+{
+    // 画像外の部分を切り捨てる
+    if (y < 0 || y >= image.getHeight())
+        return;
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 >= image.getWidth())
+        x1 = image.getWidth() - 1;
+    if (x0 > x1)
+        return;
+
+    Pixel *row = image.getRow(y);
+    if (color.b == color.g && color.g == color.r)
+    {
+        // 黒・白などの無彩色は1回の memset で書き込む
+        std::memset(row + x0, color.b, sizeof(Pixel) * (x1 - x0 + 1));
+    }
+    else
+    {
+        std::fill(row + x0, row + x1 + 1, color);
+    }
+}
+
+// 四角形の枠を描く
+void drawRect(BMPProcessor &image, int x0, int y0, int x1, int y1, const Pixel &color, int thickness)
+{
+    if (x0 > x1)
+        std::swap(x0, x1);
+    if (y0 > y1)
+        std::swap(y0, y1);
+    if (thickness < 1)
+        thickness = 1;
+
+    for (int y = y0; y <= y1; y++)
+    {
+        if (y < y0 + thickness || y > y1 - thickness)
+        {
+            // 上下の辺は1行まるごと
+            fillSpan(image, y, x0, x1, color);
+        }
+        else
+        {
+            // 左右の辺は線の太さ分だけ
+            fillSpan(image, y, x0, x0 + thickness - 1, color);
+            fillSpan(image, y, x1 - thickness + 1, x1, color);
+        }
+    }
+}
+
+// 塗りつぶした円を描く (中点円アルゴリズム)
+// 円の1/8を計算し、対称な位置の行を1回ずつ水平に塗りつぶす
+void fillCircle(BMPProcessor &image, int cx, int cy, int radius, const Pixel &color)
+{
+    if (radius < 0)
+        return;
+
+    int x = radius;
+    int y = 0;
+    int err = 1 - radius;
+
+    while (x >= y)
+    {
+        // 中心から y 行離れた行 (幅は x)
+        fillSpan(image, cy + y, cx - x, cx + x, color);
+        if (y != 0)
+            fillSpan(image, cy - y, cx - x, cx + x, color);
+
+        if (err >= 0)
+        {
+            // x が減る直前 = 中心から x 行離れた行の幅 (y) が確定した
+            if (x != y)
+            {
+                fillSpan(image, cy + x, cx - y, cx + y, color);
+                fillSpan(image, cy - x, cx - y, cx + y, color);
+            }
+            x--;
+            y++;
+            err += 2 * (y - x) + 1;
+        }
+        else
+        {
+            y++;
+            err += 2 * y + 1;
+        }
+    }
+}
+
+// int16 に収まらない値は保存すると別の値になってしまうので受け付けない
+static int16_t toInt16(int value)
+{
+    if (value < INT16_MIN || value > INT16_MAX)
+    {
+        throw std::out_of_range("Shape coordinate out of range: " + std::to_string(value));
+    }
+    return static_cast<int16_t>(value);
+}
+
+void Annotations::addRect(int x0, int y0, int x1, int y1, const Pixel &color, int thickness)
+{
+    if (thickness < 0 || thickness > UINT8_MAX)
+    {
+        throw std::out_of_range("Rectangle thickness out of range: " + std::to_string(thickness));
+    }
+
+    Shape shape = {};
+    shape.type = 0;
+    shape.thickness = uint8_t(thickness);
+    shape.color = color;
+    shape.x0 = toInt16(x0);
+    shape.y0 = toInt16(y0);
+    shape.x1 = toInt16(x1);
+    shape.y1 = toInt16(y1);
+    shapes.push_back(shape);
+}
+
+void Annotations::addCircle(int cx, int cy, int radius, const Pixel &color)
+{
+    Shape shape = {};
+    shape.type = 1;
+    shape.color = color;
+    shape.x0 = toInt16(cx);
+    shape.y0 = toInt16(cy);
+    shape.x1 = toInt16(radius);
+    shapes.push_back(shape);
+}
+
+void Annotations::render(BMPProcessor &image) const
+{
+    for (const auto &shape : shapes)
+    {
+        if (shape.type == 0)
+            drawRect(image, shape.x0, shape.y0, shape.x1, shape.y1, shape.color, shape.thickness);
+        else
+            fillCircle(image, shape.x0, shape.y0, shape.x1, shape.color);
+    }
+}
+
+// オーバーレイファイルの形式
+//   "OVL1" (4 bytes), 画像の幅 (int32), 画像の高さ (int32), 図形の数 (uint32), 図形 (16 bytes ずつ)
+void Annotations::writeOverlay(const std::string &filename, int32_t width, int32_t height) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot create file: " + filename);
+    }
+
+    uint32_t count = static_cast<uint32_t>(shapes.size());
+    file.write("OVL1", 4);
+    file.write(reinterpret_cast<const char *>(&width), sizeof(width));
+    file.write(reinterpret_cast<const char *>(&height), sizeof(height));
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char *>(shapes.data()), sizeof(Shape) * shapes.size());
+}
+
+void Annotations::readOverlay(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+
+    char magic[4];
+    int32_t fileWidth, fileHeight;
+    uint32_t count;
+    file.read(magic, 4);
+    file.read(reinterpret_cast<char *>(&fileWidth), sizeof(fileWidth));
+    file.read(reinterpret_cast<char *>(&fileHeight), sizeof(fileHeight));
+    file.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, "OVL1", 4) != 0)
+    {
+        throw std::runtime_error("Not an overlay file");
+    }
+
+    // 図形の数が壊れていても大きな領域を確保しないよう、残りのファイルサイズと比べる
+    std::streamoff header = file.tellg();
+    file.seekg(0, file.end);
+    std::streamoff remaining = file.tellg() - header;
+    file.seekg(header, file.beg);
+    if (remaining < 0 || uint64_t(count) * sizeof(Shape) > uint64_t(remaining))
+    {
+        throw std::runtime_error("Overlay file is truncated");
+    }
+
+    std::vector<Shape> loaded(count);
+    file.read(reinterpret_cast<char *>(loaded.data()), sizeof(Shape) * count);
+    if (!file)
+    {
+        throw std::runtime_error("Overlay file is truncated");
+    }
+    for (const auto &shape : loaded)
+    {
+        if (shape.type > 1)
+        {
+            throw std::runtime_error("Unknown shape type in overlay file");
+        }
+    }
+
+    shapes.swap(loaded);
+    width = fileWidth;
+    height = fileHeight;
+}
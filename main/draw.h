@@ -0,0 +1,66 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+#include "bmp.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 図形の描画
+// 1ピクセルずつではなく、水平方向の連続区間 (スパン) 単位でまとめて書き込む
+// 座標は BMPProcessor::getPixel と同じ (画像外の部分は切り捨てる)
+
+// 1行の [x0, x1] を塗りつぶす
+void fillSpan(BMPProcessor &image, int y, int x0, int x1, const Pixel &color);
+
+// 四角形の枠を描く (thickness: 線の太さ)
+void drawRect(BMPProcessor &image, int x0, int y0, int x1, int y1, const Pixel &color, int thickness = 1);
+
+// 塗りつぶした円を描く (中点円アルゴリズム)
+void fillCircle(BMPProcessor &image, int cx, int cy, int radius, const Pixel &color);
+
+// 描画内容を記録しておくクラス
+// 画像に直接描くか、図形だけを小さなオーバーレイファイルに保存できる
+// 座標はオーバーレイファイルに int16 で保存するため、範囲外の値は例外になる
+class Annotations
+{
+public:
+    // thickness は 0〜255
+    void addRect(int x0, int y0, int x1, int y1, const Pixel &color, int thickness = 1);
+    void addCircle(int cx, int cy, int radius, const Pixel &color);
+
+    // 記録した図形を画像に描画する
+    void render(BMPProcessor &image) const;
+
+    // 図形だけをオーバーレイファイルに保存・読み込みする
+    void writeOverlay(const std::string &filename, int32_t width, int32_t height) const;
+    void readOverlay(const std::string &filename);
+
+    // 読み込んだオーバーレイファイルに記録されていた画像のサイズ
+    // (画像と合っているか確認する用, 読み込む前は 0)
+    int32_t getWidth() const { return width; }
+    int32_t getHeight() const { return height; }
+
+    size_t size() const { return shapes.size(); }
+    void clear() { shapes.clear(); }
+
+private:
+#pragma pack(push, 1)
+    // オーバーレイファイルの1図形 (16 bytes)
+    struct Shape
+    {
+        uint8_t type;      // 0: 四角形の枠, 1: 塗りつぶした円
+        uint8_t thickness; // 四角形の線の太さ
+        Pixel color;       // 色 (BGR)
+        int16_t x0, y0;    // 四角形: 左上 / 円: 中心
+        int16_t x1, y1;    // 四角形: 右下 / 円: x1 に半径
+        uint8_t reserved[3];
+    };
+#pragma pack(pop)
+
+    std::vector<Shape> shapes;
+    int32_t width = 0;
+    int32_t height = 0;
+};
+
+#endif // DRAW_H